@@ -0,0 +1,45 @@
+#ifndef QUADTREE_PLUGINS_H
+#define QUADTREE_PLUGINS_H
+
+#include <Rcpp.h>
+
+// signatures of compiled split and combine functions. A pointer to a function
+// with one of these signatures, wrapped in an external pointer by
+// 'quadtree_split_ptr()' or 'quadtree_combine_ptr()', can be given to the
+// 'split_fun' and 'combine_fun' parameters of 'quadtree()', 'restructure()',
+// and 'add_layer()' instead of an R function:
+//
+//   #include <quadtree_plugins.h>
+//
+//   bool my_split(const double *vals, int n, const double *args, int n_args){
+//       ...
+//   }
+//
+//   // [[Rcpp::export]]
+//   SEXP my_split_ptr(){
+//       return quadtree_split_ptr(&my_split);
+//   }
+//
+// 'vals' contains the 'n' values in the quadrant (NA values are NaN), and
+// 'args' contains the 'n_args' values of 'split_args' (or 'combine_args'),
+// flattened into a single numeric vector. The functions are called directly
+// from C++, possibly from more than one thread at once, so they must not use
+// the R API.
+typedef bool (*quadtree_split_fun)(const double *vals, int n, const double *args, int n_args);
+typedef double (*quadtree_combine_fun)(const double *vals, int n, const double *args, int n_args);
+
+// the tags of the external pointers - the package checks them before calling
+// a function, so passing a split function as a combine function (or any other
+// external pointer) gives an error rather than a crash
+#define QUADTREE_SPLIT_FUN_TAG "quadtree_split_fun"
+#define QUADTREE_COMBINE_FUN_TAG "quadtree_combine_fun"
+
+inline SEXP quadtree_split_ptr(quadtree_split_fun fun){
+    return Rcpp::XPtr<quadtree_split_fun>(new quadtree_split_fun(fun), true, Rcpp::wrap(QUADTREE_SPLIT_FUN_TAG));
+}
+
+inline SEXP quadtree_combine_ptr(quadtree_combine_fun fun){
+    return Rcpp::XPtr<quadtree_combine_fun>(new quadtree_combine_fun(fun), true, Rcpp::wrap(QUADTREE_COMBINE_FUN_TAG));
+}
+
+#endif
@@ -0,0 +1,253 @@
+#include "BoundaryTracer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+// ------- trace -------
+// traces the outlines of each group of cells
+// PARAMETERS:
+//   nodes -> the cells to trace
+//   labels -> dictionary with node IDs as keys and labels as values. Labels
+//      must be between 0 and 'nLabels' - 1. Nodes that don't have a label (or
+//      whose label is out of range) are ignored
+//   nLabels -> the number of labels
+//   root -> the root of the quadtree - used to get the grid the cell edges
+//      fall on
+// RETURNS: a vector of length 'nLabels' - each element contains the polygons
+//   for that label. Outer rings are counter-clockwise and holes are clockwise.
+std::vector<BoundaryTracer::MultiPolygon> BoundaryTracer::trace(const std::vector<std::shared_ptr<Node>> &nodes, const NodeIndexMap &labels, const int nLabels, const Node &root){
+    // get the size of the grid we'll use for converting the coordinates to integers
+    int maxLevel{0};
+    for(auto const &node : nodes){
+        maxLevel = std::max(maxLevel, node->level);
+        for(auto const &nb : node->neighbors){
+            maxLevel = std::max(maxLevel, nb.lock()->level);
+        }
+    }
+    maxLevel = std::min(maxLevel, 60); // keeps the integer coordinates from overflowing
+    double unitX = (root.xMax - root.xMin) / std::ldexp(1.0, maxLevel);
+    double unitY = (root.yMax - root.yMin) / std::ldexp(1.0, maxLevel);
+    auto toIntX = [&root, unitX](double x) -> long long { return std::llround((x - root.xMin) / unitX); };
+    auto toIntY = [&root, unitY](double y) -> long long { return std::llround((y - root.yMin) / unitY); };
+
+    // find the boundary segments. For each side of each cell, figure out which
+    // parts of the side are shared with cells that have the same label - the
+    // parts that aren't are part of the boundary. Each shared edge is recorded
+    // for both cells, since the neighbor lists aren't guaranteed to be
+    // symmetric (e.g. when the cells aren't square).
+    NodeIndexMap indices; // Key: node ID. Value: index of the node in 'nodes'
+    for(size_t i = 0; i < nodes.size(); ++i){
+        int label = labels.get(nodes[i]->id);
+        if(label >= 0 && label < nLabels) indices.set(nodes[i]->id, i);
+    }
+    std::vector<std::array<std::vector<std::pair<long long, long long>>, 4>> covered(nodes.size()); // the parts of each side shared with a cell with the same label. 0: left, 1: right, 2: bottom, 3: top
+    for(size_t i = 0; i < nodes.size(); ++i){
+        auto const &node = nodes[i];
+        int label = labels.get(node->id);
+        if(label < 0 || label >= nLabels) continue;
+        long long x0 = toIntX(node->xMin), x1 = toIntX(node->xMax);
+        long long y0 = toIntY(node->yMin), y1 = toIntY(node->yMax);
+        for(auto const &nbWeak : node->neighbors){
+            auto nb = nbWeak.lock();
+            int j = indices.get(nb->id);
+            if(j == -1 || labels.get(nb->id) != label) continue;
+            long long nbX0 = toIntX(nb->xMin), nbX1 = toIntX(nb->xMax);
+            long long nbY0 = toIntY(nb->yMin), nbY1 = toIntY(nb->yMax);
+            int side{-1};
+            long long lo{0}, hi{0};
+            if(nbX1 == x0 || nbX0 == x1){
+                side = (nbX1 == x0) ? 0 : 1;
+                lo = std::max(y0, nbY0);
+                hi = std::min(y1, nbY1);
+            } else if(nbY1 == y0 || nbY0 == y1){
+                side = (nbY1 == y0) ? 2 : 3;
+                lo = std::max(x0, nbX0);
+                hi = std::min(x1, nbX1);
+            }
+            if(side != -1 && hi > lo){ // diagonal neighbors only share a corner, so 'hi' == 'lo'
+                covered[i][side].push_back(std::make_pair(lo, hi));
+                covered[j][side ^ 1].push_back(std::make_pair(lo, hi)); // the opposite side of the neighbor
+            }
+        }
+    }
+    std::vector<std::vector<Segment>> segments(nLabels);
+    for(size_t i = 0; i < nodes.size(); ++i){
+        auto const &node = nodes[i];
+        int label = labels.get(node->id);
+        if(label < 0 || label >= nLabels) continue;
+        long long x0 = toIntX(node->xMin), x1 = toIntX(node->xMax);
+        long long y0 = toIntY(node->yMin), y1 = toIntY(node->yMax);
+        for(int side = 0; side < 4; ++side){
+            long long start = (side < 2) ? y0 : x0;
+            long long end = (side < 2) ? y1 : x1;
+            std::sort(covered[i][side].begin(), covered[i][side].end());
+            std::vector<std::pair<long long, long long>> pieces;
+            long long cursor = start;
+            for(auto const &interval : covered[i][side]){
+                if(interval.first > cursor) pieces.push_back(std::make_pair(cursor, interval.first));
+                cursor = std::max(cursor, interval.second);
+            }
+            if(cursor < end) pieces.push_back(std::make_pair(cursor, end));
+            for(auto const &piece : pieces){ // orient the segments so that the cell is on the left
+                if(side == 0) segments[label].push_back(Segment{x0, piece.second, x0, piece.first}); // down
+                else if(side == 1) segments[label].push_back(Segment{x1, piece.first, x1, piece.second}); // up
+                else if(side == 2) segments[label].push_back(Segment{piece.first, y0, piece.second, y0}); // right
+                else segments[label].push_back(Segment{piece.second, y1, piece.first, y1}); // left
+            }
+        }
+    }
+
+    std::vector<MultiPolygon> polygons(nLabels);
+    for(int label = 0; label < nLabels; ++label){
+        std::vector<IntRing> rings = makeRings(segments[label]);
+
+        // counter-clockwise rings (positive area) are outer boundaries,
+        // clockwise rings (negative area) are holes
+        std::vector<double> areas(rings.size(), 0);
+        std::vector<int> shells;
+        std::vector<int> holes;
+        for(size_t i = 0; i < rings.size(); ++i){
+            double area{0};
+            for(size_t j = 0; j < rings[i].size(); ++j){
+                auto const &a = rings[i][j];
+                auto const &b = rings[i][(j + 1) % rings[i].size()];
+                area += static_cast<double>(a.first) * b.second - static_cast<double>(b.first) * a.second;
+            }
+            areas[i] = area / 2;
+            if(areas[i] > 0) shells.push_back(i);
+            else holes.push_back(i);
+        }
+
+        // assign each hole to the smallest outer ring that contains it. To test
+        // this we use a point just to the left of the first segment of the
+        // hole (i.e. just inside the polygon), so that the point is never on
+        // the boundary of a ring
+        std::vector<std::vector<int>> shellHoles(rings.size());
+        for(int h : holes){
+            auto const &a = rings[h][0];
+            auto const &b = rings[h][1];
+            double dx = (b.first > a.first) - (b.first < a.first);
+            double dy = (b.second > a.second) - (b.second < a.second);
+            double px = (a.first + b.first) / 2.0 - 0.25 * dy;
+            double py = (a.second + b.second) / 2.0 + 0.25 * dx;
+            int best{-1};
+            for(int s : shells){
+                if((best == -1 || areas[s] < areas[best]) && isInside(px, py, rings[s])){
+                    best = s;
+                }
+            }
+            if(best != -1){
+                shellHoles[best].push_back(h);
+            }
+        }
+
+        // convert back to the original coordinates
+        auto toPoints = [&](const IntRing &ring) -> Ring {
+            Ring pts(ring.size());
+            for(size_t i = 0; i < ring.size(); ++i){
+                pts[i] = Point(root.xMin + ring[i].first * unitX, root.yMin + ring[i].second * unitY);
+            }
+            return pts;
+        };
+        for(int s : shells){
+            Polygon polygon;
+            polygon.push_back(toPoints(rings[s]));
+            for(int h : shellHoles[s]){
+                polygon.push_back(toPoints(rings[h]));
+            }
+            polygons[label].push_back(polygon);
+        }
+    }
+    return polygons;
+}
+
+// ------- makeRings -------
+// joins the segments into closed rings. Where more than one segment leaves
+// the same vertex (which happens when two parts of a polygon touch at a
+// corner) we always take the sharpest left turn, which keeps the two parts in
+// separate rings rather than making a single self-touching ring.
+std::vector<BoundaryTracer::IntRing> BoundaryTracer::makeRings(std::vector<Segment> &segments){
+    std::sort(segments.begin(), segments.end(), [](const Segment &a, const Segment &b){
+        return a.x0 < b.x0 || (a.x0 == b.x0 && a.y0 < b.y0);
+    });
+    std::vector<char> isUsed(segments.size(), 0);
+    std::vector<IntRing> rings;
+    for(size_t start = 0; start < segments.size(); ++start){
+        if(isUsed[start]) continue;
+        IntRing ring;
+        size_t current = start;
+        while(true){
+            isUsed[current] = 1;
+            const Segment &seg = segments[current];
+            ring.push_back(std::make_pair(seg.x0, seg.y0));
+            long long dx = (seg.x1 > seg.x0) - (seg.x1 < seg.x0);
+            long long dy = (seg.y1 > seg.y0) - (seg.y1 < seg.y0);
+
+            // find the segments that start where this one ends
+            Segment key{seg.x1, seg.y1, 0, 0};
+            auto itr = std::lower_bound(segments.begin(), segments.end(), key, [](const Segment &a, const Segment &b){
+                return a.x0 < b.x0 || (a.x0 == b.x0 && a.y0 < b.y0);
+            });
+            size_t next = segments.size();
+            int nextRank{std::numeric_limits<int>::max()};
+            for(; itr != segments.end() && itr->x0 == seg.x1 && itr->y0 == seg.y1; ++itr){
+                size_t i = itr - segments.begin();
+                if(isUsed[i] && i != start) continue;
+                long long ex = (itr->x1 > itr->x0) - (itr->x1 < itr->x0);
+                long long ey = (itr->y1 > itr->y0) - (itr->y1 < itr->y0);
+                long long cross = dx * ey - dy * ex;
+                long long dot = dx * ex + dy * ey;
+                int rank = (cross > 0) ? 0 : ((cross == 0 && dot > 0) ? 1 : ((cross < 0) ? 2 : 3)); // left, straight, right, back
+                if(rank < nextRank){
+                    next = i;
+                    nextRank = rank;
+                }
+            }
+            if(next == segments.size() || next == start){ // back to the beginning
+                break;
+            }
+            current = next;
+        }
+
+        // remove the vertices in the middle of straight lines
+        IntRing simplified;
+        for(size_t i = 0; i < ring.size(); ++i){
+            auto const &prev = ring[(i + ring.size() - 1) % ring.size()];
+            auto const &pt = ring[i];
+            auto const &next = ring[(i + 1) % ring.size()];
+            long long cross = (pt.first - prev.first) * (next.second - pt.second) - (pt.second - prev.second) * (next.first - pt.first);
+            if(cross != 0){
+                simplified.push_back(pt);
+            }
+        }
+        if(simplified.size() >= 4){ // every ring has at least 4 corners since all the edges are horizontal or vertical
+            rings.push_back(simplified);
+        }
+    }
+    return rings;
+}
+
+// ------- isInside -------
+// checks whether a point is inside a ring using the ray casting method. The
+// point must not fall on a grid line in both dimensions - if 'y' is on a grid
+// line, a vertical ray is used instead of a horizontal one.
+bool BoundaryTracer::isInside(double x, double y, const IntRing &ring){
+    bool useVertical = (y == std::floor(y));
+    bool inside{false};
+    for(size_t i = 0; i < ring.size(); ++i){
+        auto const &a = ring[i];
+        auto const &b = ring[(i + 1) % ring.size()];
+        if(useVertical){
+            if((a.first > x) != (b.first > x) && a.second > y){ // only horizontal edges can cross a vertical ray
+                inside = !inside;
+            }
+        } else {
+            if((a.second > y) != (b.second > y) && a.first > x){
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
@@ -0,0 +1,46 @@
+#ifndef BOUNDARYTRACER_H
+#define BOUNDARYTRACER_H
+
+#include "Node.h"
+#include "NodeIndexMap.h"
+#include "Point.h"
+
+#include <memory>
+#include <vector>
+
+// traces the outlines of groups of cells. Each cell is given a 'label', and
+// the cells that share a label are dissolved into polygons - only the edges
+// between cells with different labels (or between a labelled cell and an
+// unlabelled one) end up in the output. Because the edges are found by looking
+// at the neighbors of each cell, the amount of work depends on the number of
+// cells being traced (not the size of the quadtree), and the size of the
+// output depends on the length of the boundaries.
+//
+// To avoid problems with comparing doubles, all of the coordinates are
+// converted to integers before tracing. Cell boundaries always fall on a
+// regular grid - the root is split in half at each level, so the cell edges
+// are all multiples of (root side length / 2^(max level)).
+class BoundaryTracer{
+public:
+    typedef std::vector<Point> Ring; // a closed ring - the first point is NOT repeated at the end
+    typedef std::vector<Ring> Polygon; // the first ring is the outer boundary, the others are holes
+    typedef std::vector<Polygon> MultiPolygon;
+
+    static std::vector<MultiPolygon> trace(const std::vector<std::shared_ptr<Node>> &nodes, const NodeIndexMap &labels, const int nLabels, const Node &root);
+
+private:
+    // a piece of the boundary, going from (x0,y0) to (x1,y1). Segments are
+    // oriented so that the inside of the polygon is on the left.
+    struct Segment{
+        long long x0;
+        long long y0;
+        long long x1;
+        long long y1;
+    };
+    typedef std::vector<std::pair<long long, long long>> IntRing;
+
+    static std::vector<IntRing> makeRings(std::vector<Segment> &segments);
+    static bool isInside(double x, double y, const IntRing &ring);
+};
+
+#endif
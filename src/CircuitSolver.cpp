@@ -0,0 +1,254 @@
+#include "CircuitSolver.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// ------- SparseMatrix -------
+int CircuitSolver::SparseMatrix::nRow() const{
+    return static_cast<int>(offsets.size()) - 1;
+}
+
+// computes 'y = Ax'. The rows are split between the threads, so each thread
+// writes to a separate part of 'y'.
+void CircuitSolver::SparseMatrix::multiply(const std::vector<double> &x, std::vector<double> &y, int nThreads) const{
+    int n = nRow();
+    y.resize(n);
+    parallel::forRange(n, parallel::getNThreads(nThreads, n, 4096), [&](int begin, int end, int){
+        for(int i = begin; i < end; ++i){
+            double sum{0};
+            for(int k = offsets[i]; k < offsets[i + 1]; ++k){
+                sum += values[k] * x[columns[k]];
+            }
+            y[i] = sum;
+        }
+    });
+}
+
+// ------- CircuitSolver -------
+// calculates the conductance of each edge and finds the connected components
+CircuitSolver::CircuitSolver(const LeafGraph &_graph) : graph{_graph} {
+    int n = graph.size();
+    conductances.assign(graph.adjacency.size(), 0);
+    for(int i = 0; i < n; ++i){
+        const Node &a = *graph.leaves[i];
+        for(int k = graph.offsets[i]; k < graph.offsets[i + 1]; ++k){
+            const Node &b = *graph.leaves[graph.adjacency[k]];
+            double eps = 1e-9 * std::min(a.xMax - a.xMin, a.yMax - a.yMin);
+            double overlapX = std::min(a.xMax, b.xMax) - std::max(a.xMin, b.xMin);
+            double overlapY = std::min(a.yMax, b.yMax) - std::max(a.yMin, b.yMin);
+            double length{0}, distA{0}, distB{0};
+            if(overlapY > eps && overlapX <= eps){ // side by side
+                length = overlapY;
+                distA = (a.xMax - a.xMin) / 2;
+                distB = (b.xMax - b.xMin) / 2;
+            } else if(overlapX > eps && overlapY <= eps){ // one above the other
+                length = overlapX;
+                distA = (a.yMax - a.yMin) / 2;
+                distB = (b.yMax - b.yMin) / 2;
+            }
+            if(length > 0){
+                if(a.value <= 0 || b.value <= 0){
+                    throw std::runtime_error("cell values must be greater than 0 to be used as resistances");
+                }
+                conductances[k] = length / (a.value * distA + b.value * distB);
+            }
+        }
+    }
+
+    // find the components - cells that only touch at a corner aren't connected
+    components.assign(n, -1);
+    int nComponents{0};
+    std::vector<int> stack;
+    for(int i = 0; i < n; ++i){
+        if(components[i] != -1 || std::isnan(graph.leaves[i]->value)) continue;
+        components[i] = nComponents;
+        stack.push_back(i);
+        while(!stack.empty()){
+            int j = stack.back();
+            stack.pop_back();
+            for(int k = graph.offsets[j]; k < graph.offsets[j + 1]; ++k){
+                int nb = graph.adjacency[k];
+                if(conductances[k] > 0 && components[nb] == -1){
+                    components[nb] = nComponents;
+                    stack.push_back(nb);
+                }
+            }
+        }
+        ++nComponents;
+    }
+}
+
+// ------- solve -------
+// solves 'mat * x = rhs' using the conjugate gradient method with a Jacobi
+// (diagonal) preconditioner. 'mat' must be symmetric and positive definite.
+std::vector<double> CircuitSolver::solve(const SparseMatrix &mat, const std::vector<double> &diag, const std::vector<double> &rhs) const{
+    int n = mat.nRow();
+    auto dot = [n](const std::vector<double> &a, const std::vector<double> &b){
+        double sum{0};
+        for(int i = 0; i < n; ++i) sum += a[i] * b[i];
+        return sum;
+    };
+    std::vector<double> x(n, 0);
+    std::vector<double> r(rhs);
+    std::vector<double> z(n);
+    for(int i = 0; i < n; ++i) z[i] = r[i] / diag[i];
+    std::vector<double> p(z);
+    std::vector<double> ap(n);
+    double rz = dot(r, z);
+    double limit = tolerance * std::sqrt(dot(rhs, rhs));
+    int maxIter = maxIterations < 0 ? n + 100 : maxIterations;
+    for(int iter = 0; iter < maxIter; ++iter){
+        if(std::sqrt(dot(r, r)) <= limit){
+            return x;
+        }
+        mat.multiply(p, ap, nThreads);
+        double alpha = rz / dot(p, ap);
+        for(int i = 0; i < n; ++i){
+            x[i] += alpha * p[i];
+            r[i] -= alpha * ap[i];
+            z[i] = r[i] / diag[i];
+        }
+        double rzNew = dot(r, z);
+        double beta = rzNew / rz;
+        rz = rzNew;
+        for(int i = 0; i < n; ++i){
+            p[i] = z[i] + beta * p[i];
+        }
+    }
+    if(std::sqrt(dot(r, r)) > limit){
+        throw std::runtime_error("the conjugate gradient solver did not converge in " + std::to_string(maxIter) + " iterations");
+    }
+    return x;
+}
+
+// ------- getPairwise -------
+// calculates the effective resistance between every pair of nodes, and the
+// total current that flows through each leaf when one unit of current is
+// passed between every pair of nodes (one pair at a time).
+//
+// Since voltage differences don't depend on which node is grounded, only one
+// solve is needed per node (minus one per component): we ground the last node
+// in each component, and then for each other node 'a' find the voltages 'v_a'
+// that result from injecting one unit of current at 'a'. The voltages for
+// passing current from 'a' to 'b' are then 'v_a - v_b'.
+// PARAMETERS:
+//   nodes -> indices (in 'graph.leaves') of the nodes. NA leaves (or -1) are
+//      allowed - they give NA resistances.
+//   resistances -> filled with a 'nodes.size()' by 'nodes.size()' matrix
+//      (stored by row) of effective resistances. Resistances between
+//      different components are infinite, and resistances involving NA cells
+//      are NaN
+//   currents -> filled with the total current through each leaf. NaN for
+//      leaves that aren't in a component that contains at least one node
+void CircuitSolver::getPairwise(const std::vector<int> &nodes, std::vector<double> &resistances, std::vector<double> &currents) const{
+    int n = graph.size();
+    int k = nodes.size();
+    resistances.assign(k * k, std::numeric_limits<double>::infinity());
+    currents.assign(n, std::numeric_limits<double>::quiet_NaN());
+
+    // group the nodes by component
+    std::vector<std::vector<int>> groups; // each element holds indices (in 'nodes') of the nodes in one component
+    std::vector<int> groupComponents;
+    for(int i = 0; i < k; ++i){
+        int comp = (nodes[i] < 0 || nodes[i] >= n) ? -1 : components[nodes[i]];
+        if(comp == -1){
+            for(int j = 0; j < k; ++j){
+                resistances[i * k + j] = std::numeric_limits<double>::quiet_NaN();
+                resistances[j * k + i] = std::numeric_limits<double>::quiet_NaN();
+            }
+            continue;
+        }
+        auto itr = std::find(groupComponents.begin(), groupComponents.end(), comp);
+        if(itr == groupComponents.end()){
+            groupComponents.push_back(comp);
+            groups.push_back(std::vector<int>{i});
+        } else {
+            groups[itr - groupComponents.begin()].push_back(i);
+        }
+    }
+
+    for(size_t g = 0; g < groups.size(); ++g){
+        const std::vector<int> &group = groups[g];
+        int ground = nodes[group.back()];
+
+        // give each leaf in the component (other than the ground) a row
+        std::vector<int> compLeaves; // all the leaves in the component
+        std::vector<int> leafIndices; // index of each row's leaf in 'graph.leaves'
+        std::vector<int> rows(n, -1); // row of each leaf
+        for(int i = 0; i < n; ++i){
+            if(components[i] == groupComponents[g]){
+                currents[i] = 0;
+                compLeaves.push_back(i);
+                if(i != ground){
+                    rows[i] = leafIndices.size();
+                    leafIndices.push_back(i);
+                }
+            }
+        }
+
+        // build the grounded Laplacian - the row and column for the ground
+        // are removed, which makes the matrix positive definite
+        SparseMatrix mat;
+        std::vector<double> diag(leafIndices.size(), 0);
+        mat.offsets.push_back(0);
+        for(size_t r = 0; r < leafIndices.size(); ++r){
+            int i = leafIndices[r];
+            mat.columns.push_back(r);
+            mat.values.push_back(0);
+            size_t diagIndex = mat.values.size() - 1;
+            for(int e = graph.offsets[i]; e < graph.offsets[i + 1]; ++e){
+                if(conductances[e] > 0){
+                    diag[r] += conductances[e];
+                    int col = rows[graph.adjacency[e]];
+                    if(col != -1){
+                        mat.columns.push_back(col);
+                        mat.values.push_back(-conductances[e]);
+                    }
+                }
+            }
+            mat.values[diagIndex] = diag[r];
+            mat.offsets.push_back(mat.columns.size());
+        }
+
+        // get the voltages that result from injecting one unit of current at
+        // each node (the ground is always at 0)
+        std::vector<std::vector<double>> voltages(group.size(), std::vector<double>(n, 0));
+        for(size_t a = 0; a < group.size(); ++a){
+            int leaf = nodes[group[a]];
+            if(leaf == ground) continue;
+            std::vector<double> rhs(leafIndices.size(), 0);
+            rhs[rows[leaf]] = 1;
+            std::vector<double> x = solve(mat, diag, rhs);
+            for(size_t r = 0; r < leafIndices.size(); ++r){
+                voltages[a][leafIndices[r]] = x[r];
+            }
+        }
+
+        for(size_t a = 0; a < group.size(); ++a){
+            int leafA = nodes[group[a]];
+            resistances[group[a] * k + group[a]] = 0;
+            for(size_t b = a + 1; b < group.size(); ++b){
+                int leafB = nodes[group[b]];
+                double resistance = voltages[a][leafA] - voltages[b][leafA] - voltages[a][leafB] + voltages[b][leafB];
+                resistances[group[a] * k + group[b]] = resistance;
+                resistances[group[b] * k + group[a]] = resistance;
+                if(leafA == leafB) continue;
+
+                // the current through a leaf is half of the total current
+                // flowing in and out of it (including the injected current)
+                for(int i : compLeaves){
+                    double sum = (i == leafA || i == leafB) ? 1 : 0;
+                    double vi = voltages[a][i] - voltages[b][i];
+                    for(int e = graph.offsets[i]; e < graph.offsets[i + 1]; ++e){
+                        int j = graph.adjacency[e];
+                        sum += conductances[e] * std::abs(vi - (voltages[a][j] - voltages[b][j]));
+                    }
+                    currents[i] += sum / 2;
+                }
+            }
+        }
+    }
+}
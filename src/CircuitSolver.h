@@ -0,0 +1,52 @@
+#ifndef CIRCUITSOLVER_H
+#define CIRCUITSOLVER_H
+
+#include "LeafGraph.h"
+
+#include <vector>
+
+// treats the leaves of a quadtree as an electrical circuit and uses it to
+// calculate effective resistances and current flow between points (i.e. the
+// approach used by Circuitscape).
+//
+// Each non-NA cell is a node in the circuit, and the values of the cells are
+// treated as resistances (per unit length, just as they're treated as costs by
+// 'LcpFinder'). Two cells are connected if they share part of an edge (cells
+// that only touch at a corner aren't connected). The conductance between two
+// cells is the length of the shared edge divided by the resistance of the path
+// from one centroid to the other - so for two cells with the same size, this
+// is 1 divided by the mean of the two resistances, which is what Circuitscape
+// uses for a raster.
+//
+// The voltages are found by solving the graph Laplacian (grounded at one
+// node) with a Jacobi-preconditioned conjugate gradient solver. The sparse
+// matrix-vector product can be split across threads.
+class CircuitSolver{
+public:
+    // a symmetric sparse matrix in CSR format
+    struct SparseMatrix{
+        std::vector<int> offsets;
+        std::vector<int> columns;
+        std::vector<double> values;
+
+        int nRow() const;
+        void multiply(const std::vector<double> &x, std::vector<double> &y, int nThreads) const;
+    };
+
+    const LeafGraph &graph;
+    std::vector<double> conductances; // conductance of each edge - same order as 'graph.adjacency'. 0 for cells that only touch at a corner
+    std::vector<int> components; // the component (of cells connected by non-zero conductances) of each leaf, or -1 for NA leaves
+
+    int nThreads{1};
+    double tolerance{1e-8}; // the solver stops when the norm of the residual is less than 'tolerance' times the norm of the right-hand side
+    int maxIterations{-1}; // the maximum number of iterations of the solver. If negative, the number of unknowns (plus 100) is used
+
+    CircuitSolver(const LeafGraph &_graph);
+
+    void getPairwise(const std::vector<int> &nodes, std::vector<double> &resistances, std::vector<double> &currents) const;
+
+private:
+    std::vector<double> solve(const SparseMatrix &mat, const std::vector<double> &diag, const std::vector<double> &rhs) const;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "ClassCounts.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// ------- constructors -------
+ClassCounts::ClassCounts(){}
+
+// counts the classes in 'vals' (NaN values are ignored). If every value is an
+// integer and the range of the values isn't much larger than the number of
+// values (which is usually the case for class codes), the values are counted
+// directly in an array - otherwise they're sorted.
+ClassCounts::ClassCounts(const std::vector<double> &vals){
+    std::vector<double> valsNoNA;
+    valsNoNA.reserve(vals.size());
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    bool allIntegers{true};
+    for(double val : vals){
+        if(std::isnan(val)) continue;
+        valsNoNA.push_back(val);
+        if(val < min) min = val;
+        if(val > max) max = val;
+        if(allIntegers && val != std::floor(val)) allIntegers = false;
+    }
+    if(valsNoNA.empty()) return;
+
+    if(allIntegers && max - min <= 4.0 * valsNoNA.size() + 256){
+        std::vector<int> bins(static_cast<size_t>(max - min) + 1, 0);
+        for(double val : valsNoNA){
+            ++bins[static_cast<size_t>(val - min)];
+        }
+        for(size_t i = 0; i < bins.size(); ++i){
+            if(bins[i] == 0) continue;
+            classes.push_back(min + i);
+            counts.push_back(bins[i]);
+        }
+        return;
+    }
+
+    std::sort(valsNoNA.begin(), valsNoNA.end());
+    for(double val : valsNoNA){
+        if(classes.empty() || classes.back() != val){
+            classes.push_back(val);
+            counts.push_back(0);
+        }
+        ++counts.back();
+    }
+}
+
+ClassCounts::ClassCounts(const Matrix &mat)
+    : ClassCounts{mat.vec}{}
+
+// ------- add -------
+// adds the counts from another histogram - since both are sorted by class,
+// this is a single merge
+void ClassCounts::add(const ClassCounts &other){
+    std::vector<double> newClasses, newCounts;
+    newClasses.reserve(classes.size() + other.classes.size());
+    newCounts.reserve(classes.size() + other.classes.size());
+    size_t i{0}, j{0};
+    while(i < classes.size() || j < other.classes.size()){
+        if(j == other.classes.size() || (i < classes.size() && classes[i] < other.classes[j])){
+            newClasses.push_back(classes[i]);
+            newCounts.push_back(counts[i++]);
+        } else if(i == classes.size() || other.classes[j] < classes[i]){
+            newClasses.push_back(other.classes[j]);
+            newCounts.push_back(other.counts[j++]);
+        } else {
+            newClasses.push_back(classes[i]);
+            newCounts.push_back(counts[i++] + other.counts[j++]);
+        }
+    }
+    classes.swap(newClasses);
+    counts.swap(newCounts);
+}
+
+int ClassCounts::nClasses() const{
+    return classes.size();
+}
+
+double ClassCounts::total() const{
+    double sum{0};
+    for(double count : counts) sum += count;
+    return sum;
+}
+
+// ------- mode -------
+// returns the most common class. Ties go to the smallest class. Returns NaN if
+// there are no values.
+double ClassCounts::mode() const{
+    if(classes.empty()) return std::numeric_limits<double>::quiet_NaN();
+    size_t best{0};
+    for(size_t i = 1; i < counts.size(); ++i){
+        if(counts[i] > counts[best]) best = i;
+    }
+    return classes[best];
+}
+
+// ------- entropy -------
+// returns the Shannon entropy of the classes, in bits - 0 if there's only one
+// class, 1 if there are two equally common classes, and so on. Returns 0 if
+// there are no values.
+double ClassCounts::entropy() const{
+    double n = total();
+    double entropy{0};
+    for(double count : counts){
+        double p = count / n;
+        entropy -= p * std::log2(p);
+    }
+    return entropy;
+}
+
+// ------- purity -------
+// returns the proportion of the values that are in the most common class.
+// Returns NaN if there are no values.
+double ClassCounts::purity() const{
+    if(classes.empty()) return std::numeric_limits<double>::quiet_NaN();
+    return *std::max_element(counts.begin(), counts.end()) / total();
+}
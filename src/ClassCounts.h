@@ -0,0 +1,35 @@
+#ifndef CLASSCOUNTS_H
+#define CLASSCOUNTS_H
+
+#include "Matrix.h"
+
+#include <vector>
+
+// histogram of the (non-NA) values in a quadrant, for rasters where the
+// values are classes (e.g. land cover). Used by the categorical split and
+// combine methods ("n_classes", "entropy", "purity", and "mode").
+//
+// The classes are stored in increasing order along with the number of times
+// each occurs, so the memory used depends on the number of classes in the
+// quadrant rather than on the number of possible classes. Since the counts of
+// a quadrant are the sum of the counts of its four children, histograms can
+// be merged with 'add()' instead of being recalculated from the values.
+class ClassCounts{
+public:
+    std::vector<double> classes; // the classes, in increasing order
+    std::vector<double> counts; // the number of values in each class
+
+    ClassCounts();
+    ClassCounts(const std::vector<double> &vals);
+    ClassCounts(const Matrix &mat);
+
+    void add(const ClassCounts &other);
+
+    int nClasses() const;
+    double total() const;
+    double mode() const;
+    double entropy() const;
+    double purity() const;
+};
+
+#endif
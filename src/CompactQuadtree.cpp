@@ -0,0 +1,573 @@
+#include "CompactQuadtree.h"
+
+#include "QuadtreeInfo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+const char CompactQuadtree::MAGIC[8] = {'Q', 'T', 'C', 'M', 'P', 'C', 'T', '\0'};
+const uint32_t CompactQuadtree::VERSION = 1;
+
+namespace {
+    const int MAX_LEVEL = 64; // deeper than any quadtree made from a matrix can be - used to detect corrupted files
+    const size_t BUFFER_SIZE = 1 << 16;
+
+    std::runtime_error invalidFile(const std::string &filePath, const std::string &reason){
+        return std::runtime_error("'" + filePath + "' is not a valid compact quadtree file: " + reason);
+    }
+
+    // ------- little-endian numbers -------
+    void putUInt(std::ostream &os, uint64_t val, int nBytes){
+        char bytes[8];
+        for(int i = 0; i < nBytes; ++i){
+            bytes[i] = static_cast<char>((val >> (8 * i)) & 0xFF);
+        }
+        os.write(bytes, nBytes);
+    }
+
+    void putDouble(std::ostream &os, double val){
+        uint64_t bits;
+        std::memcpy(&bits, &val, sizeof(double));
+        putUInt(os, bits, 8);
+    }
+
+    void putString(std::ostream &os, const std::string &str){
+        putUInt(os, str.size(), 8);
+        os.write(str.data(), str.size());
+    }
+
+    uint64_t getUInt(std::istream &is, int nBytes, const std::string &filePath){
+        unsigned char bytes[8];
+        if(!is.read(reinterpret_cast<char*>(bytes), nBytes)) throw invalidFile(filePath, "the file is truncated");
+        uint64_t val{0};
+        for(int i = 0; i < nBytes; ++i){
+            val |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        }
+        return val;
+    }
+
+    double getDouble(std::istream &is, const std::string &filePath){
+        uint64_t bits = getUInt(is, 8, filePath);
+        double val;
+        std::memcpy(&val, &bits, sizeof(double));
+        return val;
+    }
+
+    std::string getString(std::istream &is, const std::string &filePath){
+        uint64_t length = getUInt(is, 8, filePath);
+        if(length > (1u << 30)) throw invalidFile(filePath, "invalid string length");
+        std::string str(length, '\0');
+        if(length > 0 && !is.read(&str[0], length)) throw invalidFile(filePath, "the file is truncated");
+        return str;
+    }
+
+    // ------- range coder -------
+    // adaptive binary range coder (the same design as the one used by LZMA).
+    // Each probability is the 11-bit probability that the next bit is 0, and
+    // it's updated after every bit. Bytes and other multi-bit symbols are
+    // coded one bit at a time, from the most significant bit, using a binary
+    // tree of probabilities so that each bit depends on the bits before it.
+    const int PROB_BITS = 11;
+    const uint16_t PROB_INIT = 1 << (PROB_BITS - 1);
+    const int MOVE_BITS = 5;
+    const uint32_t TOP = 1u << 24;
+
+    class RangeEncoder{
+        std::ostream &os;
+        std::vector<char> buffer;
+        uint64_t low{0};
+        uint32_t range{0xFFFFFFFF};
+        uint8_t cache{0};
+        uint64_t cacheSize{1};
+
+        void put(uint8_t byte){
+            buffer.push_back(static_cast<char>(byte));
+            if(buffer.size() == BUFFER_SIZE){
+                os.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+
+        // writes the top byte of 'low', unless it could still change because
+        // of a carry - in that case it's held back (along with any 0xFF bytes
+        // after it) until the carry is known
+        void shiftLow(){
+            if(static_cast<uint32_t>(low) < 0xFF000000u || (low >> 32) != 0){
+                uint8_t carry = static_cast<uint8_t>(low >> 32);
+                uint8_t byte = cache;
+                do{
+                    put(byte + carry);
+                    byte = 0xFF;
+                } while(--cacheSize != 0);
+                cache = static_cast<uint8_t>(low >> 24);
+            }
+            ++cacheSize;
+            low = (low & 0x00FFFFFF) << 8;
+        }
+
+    public:
+        RangeEncoder(std::ostream &_os) : os{_os} {
+            buffer.reserve(BUFFER_SIZE);
+        }
+
+        void encodeBit(uint16_t &prob, int bit){
+            uint32_t bound = (range >> PROB_BITS) * prob;
+            if(bit == 0){
+                range = bound;
+                prob += ((1 << PROB_BITS) - prob) >> MOVE_BITS;
+            } else {
+                low += bound;
+                range -= bound;
+                prob -= prob >> MOVE_BITS;
+            }
+            while(range < TOP){
+                range <<= 8;
+                shiftLow();
+            }
+        }
+
+        // 'probs' must have at least 2^nBits elements
+        void encodeTree(uint16_t *probs, uint32_t symbol, int nBits){
+            uint32_t m{1};
+            for(int i = nBits - 1; i >= 0; --i){
+                int bit = (symbol >> i) & 1;
+                encodeBit(probs[m], bit);
+                m = (m << 1) | bit;
+            }
+        }
+
+        void finish(){
+            for(int i = 0; i < 5; ++i){
+                shiftLow();
+            }
+            os.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    };
+
+    class RangeDecoder{
+        std::istream &is;
+        const std::string &filePath;
+        std::vector<char> buffer;
+        size_t pos{0};
+        size_t end{0};
+        uint32_t range{0xFFFFFFFF};
+        uint32_t code{0};
+
+        uint8_t next(){
+            if(pos == end){
+                is.read(buffer.data(), buffer.size());
+                end = is.gcount();
+                pos = 0;
+                if(end == 0) throw invalidFile(filePath, "the file is truncated");
+            }
+            return static_cast<uint8_t>(buffer[pos++]);
+        }
+
+    public:
+        RangeDecoder(std::istream &_is, const std::string &_filePath) : is{_is}, filePath{_filePath}, buffer(BUFFER_SIZE) {
+            for(int i = 0; i < 5; ++i){
+                code = (code << 8) | next();
+            }
+        }
+
+        int decodeBit(uint16_t &prob){
+            uint32_t bound = (range >> PROB_BITS) * prob;
+            int bit;
+            if(code < bound){
+                range = bound;
+                prob += ((1 << PROB_BITS) - prob) >> MOVE_BITS;
+                bit = 0;
+            } else {
+                code -= bound;
+                range -= bound;
+                prob -= prob >> MOVE_BITS;
+                bit = 1;
+            }
+            while(range < TOP){
+                range <<= 8;
+                code = (code << 8) | next();
+            }
+            return bit;
+        }
+
+        uint32_t decodeTree(uint16_t *probs, int nBits){
+            uint32_t m{1};
+            for(int i = 0; i < nBits; ++i){
+                m = (m << 1) | decodeBit(probs[m]);
+            }
+            return m - (1u << nBits);
+        }
+    };
+
+    // ------- models -------
+    // the probabilities used to code the nodes. Each difference is coded as
+    // the number of bytes it needs (0 to 8), followed by those bytes starting
+    // from the most significant one. The first byte is never 0, so it gets its
+    // own probabilities.
+    struct Models{
+        std::vector<uint16_t> split;
+        std::vector<uint16_t> nBytes; // 16 per level
+        std::vector<uint16_t> topByte; // 256 per number of bytes
+        std::vector<uint16_t> otherBytes; // 256 per byte position
+
+        Models() : split(MAX_LEVEL + 1, PROB_INIT), nBytes(16 * (MAX_LEVEL + 1), PROB_INIT), topByte(256 * 8, PROB_INIT), otherBytes(256 * 8, PROB_INIT) {}
+    };
+
+    int countBytes(uint64_t val){
+        int n{0};
+        while(val != 0){
+            ++n;
+            val >>= 8;
+        }
+        return n;
+    }
+
+    void encodeSymbol(RangeEncoder &enc, Models &models, uint64_t symbol, int level){
+        int n = countBytes(symbol);
+        enc.encodeTree(&models.nBytes[16 * level], n, 4);
+        for(int i = n - 1; i >= 0; --i){
+            uint16_t *probs = i == n - 1 ? &models.topByte[256 * i] : &models.otherBytes[256 * i];
+            enc.encodeTree(probs, (symbol >> (8 * i)) & 0xFF, 8);
+        }
+    }
+
+    uint64_t decodeSymbol(RangeDecoder &dec, Models &models, int level, const std::string &filePath){
+        int n = dec.decodeTree(&models.nBytes[16 * level], 4);
+        if(n > 8) throw invalidFile(filePath, "invalid value");
+        uint64_t symbol{0};
+        for(int i = n - 1; i >= 0; --i){
+            uint16_t *probs = i == n - 1 ? &models.topByte[256 * i] : &models.otherBytes[256 * i];
+            symbol |= static_cast<uint64_t>(dec.decodeTree(probs, 8)) << (8 * i);
+        }
+        return symbol;
+    }
+
+    // ------- value coding -------
+    // converts values to and from the symbols that are coded. Each value has
+    // a "key" - the bits of the value if the values are stored exactly, or the
+    // integer multiple of 'precision' otherwise (0 for NA). The symbol for a
+    // value is based on the difference between its key and its parent's key.
+    class ValueCoder{
+        ValueVector::Type type;
+        double precision;
+
+    public:
+        ValueCoder(ValueVector::Type _type, double _precision) : type{_type}, precision{_precision} {}
+
+        uint64_t toSymbol(double val, uint64_t parentKey, uint64_t &key) const{
+            if(precision > 0){
+                if(std::isnan(val)){
+                    key = 0;
+                    return 0;
+                }
+                double scaled = std::round(val / precision);
+                if(!(std::fabs(scaled) <= 9007199254740992.0)){ // 2^53
+                    throw std::runtime_error("unable to write the quadtree - 'precision' is too small for the value " + std::to_string(val));
+                }
+                int64_t q = static_cast<int64_t>(scaled);
+                key = static_cast<uint64_t>(q);
+                int64_t diff = q - static_cast<int64_t>(parentKey);
+                return ((static_cast<uint64_t>(diff) << 1) ^ static_cast<uint64_t>(diff >> 63)) + 1; // zigzag, so small negative numbers are small
+            }
+            if(type == ValueVector::Type::Float){
+                float f = static_cast<float>(val);
+                uint32_t bits;
+                std::memcpy(&bits, &f, sizeof(float));
+                key = bits;
+            } else {
+                std::memcpy(&key, &val, sizeof(double));
+            }
+            return key ^ parentKey;
+        }
+
+        double fromSymbol(uint64_t symbol, uint64_t parentKey, uint64_t &key) const{
+            if(precision > 0){
+                if(symbol == 0){
+                    key = 0;
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+                uint64_t zigzag = symbol - 1;
+                int64_t diff = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+                key = parentKey + static_cast<uint64_t>(diff);
+                int64_t q = static_cast<int64_t>(key);
+                return q * precision;
+            }
+            key = symbol ^ parentKey;
+            if(type == ValueVector::Type::Float){
+                uint32_t bits = static_cast<uint32_t>(key);
+                float f;
+                std::memcpy(&f, &bits, sizeof(float));
+                return f;
+            }
+            double val;
+            std::memcpy(&val, &key, sizeof(double));
+            return val;
+        }
+    };
+
+    CompactQuadtree::Header readHeaderFrom(std::istream &is, const std::string &filePath){
+        char magic[sizeof(CompactQuadtree::MAGIC)];
+        if(!is.read(magic, sizeof(magic)) || std::memcmp(magic, CompactQuadtree::MAGIC, sizeof(magic)) != 0){
+            throw invalidFile(filePath, "the file doesn't start with the expected bytes");
+        }
+        CompactQuadtree::Header head;
+        head.version = getUInt(is, 4, filePath);
+        if(head.version != CompactQuadtree::VERSION){
+            throw invalidFile(filePath, "unsupported version (" + std::to_string(head.version) + ")");
+        }
+        head.nNodes = getUInt(is, 8, filePath);
+        head.nLeaves = getUInt(is, 8, filePath);
+        head.matNX = getUInt(is, 4, filePath);
+        head.matNY = getUInt(is, 4, filePath);
+        head.splitAllNAs = getUInt(is, 1, filePath);
+        head.splitAnyNAs = getUInt(is, 1, filePath);
+        int valueType = getUInt(is, 1, filePath);
+        head.nLayers = getUInt(is, 4, filePath);
+        head.activeLayer = getUInt(is, 4, filePath);
+        head.precision = getDouble(is, filePath);
+        head.xMin = getDouble(is, filePath);
+        head.xMax = getDouble(is, filePath);
+        head.yMin = getDouble(is, filePath);
+        head.yMax = getDouble(is, filePath);
+        head.maxXCellLength = getDouble(is, filePath);
+        head.maxYCellLength = getDouble(is, filePath);
+        head.minXCellLength = getDouble(is, filePath);
+        head.minYCellLength = getDouble(is, filePath);
+        for(int i = 0; i < 6; ++i){
+            head.original.push_back(getDouble(is, filePath));
+        }
+        if(head.nNodes < 1 || head.nNodes > std::numeric_limits<int>::max() || head.nLeaves < 1 || head.nLeaves > head.nNodes) throw invalidFile(filePath, "invalid number of nodes");
+        if(valueType > static_cast<int>(ValueVector::Type::UInt8)) throw invalidFile(filePath, "invalid value type");
+        head.valueType = static_cast<ValueVector::Type>(valueType);
+        if(head.nLayers < 0 || head.activeLayer < 0 || head.activeLayer >= std::max(head.nLayers, 1)) throw invalidFile(filePath, "invalid layers");
+        if(!(head.precision >= 0)) throw invalidFile(filePath, "invalid precision");
+        head.projection = getString(is, filePath);
+        for(int i = 0; i < head.nLayers; ++i){
+            head.layerNames.push_back(getString(is, filePath));
+        }
+        return head;
+    }
+
+    // returns the offset of the compact data - i.e. the size of the
+    // 'QuadtreeInfo' header
+    uint64_t dataOffset(const std::string &filePath){
+        if(!QuadtreeInfo::hasInfo(filePath)) throw invalidFile(filePath, "unrecognized format");
+        QuadtreeInfo info = QuadtreeInfo::read(filePath);
+        if(info.format != QuadtreeInfo::Format::Compact) throw invalidFile(filePath, "it was written in the '" + QuadtreeInfo::formatToString(info.format) + "' format");
+        return info.headerSize;
+    }
+
+    // ------- decoding -------
+    // recursively reads a node (and its children) from the file
+    class NodeDecoder{
+        RangeDecoder &dec;
+        const CompactQuadtree::Header &head;
+        const std::string &filePath;
+        ValueCoder coder;
+        Models models;
+        int nVals;
+        std::vector<uint64_t> keys; // the keys of the node's ancestors - 'nVals' per level
+        int nextId{0};
+
+    public:
+        std::vector<std::vector<double>> layerVals; // empty if the quadtree only has one layer
+
+        NodeDecoder(RangeDecoder &_dec, const CompactQuadtree::Header &_head, const std::string &_filePath)
+            : dec{_dec}, head{_head}, filePath{_filePath}, coder{_head.valueType, _head.precision}, nVals{std::max(_head.nLayers, 1)},
+              keys(nVals * (MAX_LEVEL + 2), 0), layerVals(_head.nLayers, std::vector<double>(_head.nNodes)) {}
+
+        int nNodes() const{
+            return nextId;
+        }
+
+        std::shared_ptr<Node> decode(double xMin, double xMax, double yMin, double yMax, int level){
+            if(nextId >= head.nNodes) throw invalidFile(filePath, "the file has more nodes than the header says");
+            if(level > MAX_LEVEL) throw invalidFile(filePath, "the tree is too deep");
+            auto node = std::make_shared<Node>(xMin, xMax, yMin, yMax, 0, nextId++, level);
+            node->hasChildren = dec.decodeBit(models.split[level]);
+            for(int i = 0; i < nVals; ++i){
+                uint64_t symbol = decodeSymbol(dec, models, level, filePath);
+                double val = coder.fromSymbol(symbol, keys[level * nVals + i], keys[(level + 1) * nVals + i]);
+                if(head.nLayers > 0) layerVals[i][node->id] = val;
+                if(i == head.activeLayer) node->value = ValueVector::convert(head.valueType, val);
+            }
+            if(node->hasChildren){
+                double xLength = (xMax - xMin) / 2; // same as 'Quadtree::makeTree()'
+                double yLength = (yMax - yMin) / 2;
+                for(int r = 0; r < 2; ++r){
+                    for(int c = 0; c < 2; ++c){
+                        double childXMin = xMin + c * xLength;
+                        double childYMin = yMin + (1 - r) * yLength;
+                        auto child = decode(childXMin, childXMin + xLength, childYMin, childYMin + yLength, level + 1);
+                        node->children[(1 - r) * 2 + c] = child;
+                        node->smallestChildSideLength = std::min(node->smallestChildSideLength, child->smallestChildSideLength);
+                    }
+                }
+            }
+            return node;
+        }
+    };
+
+    // ------- encoding -------
+    class NodeEncoder{
+        RangeEncoder &enc;
+        ValueCoder coder;
+        Models models;
+        int nVals;
+        std::vector<uint64_t> keys;
+        const std::vector<std::vector<double>> &layerVals; // empty if the quadtree only has one layer
+
+    public:
+        NodeEncoder(RangeEncoder &_enc, const Quadtree &_quadtree, double precision, const std::vector<std::vector<double>> &_layerVals)
+            : enc{_enc}, coder{_quadtree.valueType, precision}, nVals{std::max(static_cast<int>(_layerVals.size()), 1)},
+              keys(nVals * (MAX_LEVEL + 2), 0), layerVals{_layerVals} {}
+
+        void encode(const Node &node, int level){
+            enc.encodeBit(models.split[level], node.hasChildren);
+            for(int i = 0; i < nVals; ++i){
+                double val = layerVals.empty() ? node.value : layerVals[i][node.id];
+                uint64_t symbol = coder.toSymbol(val, keys[level * nVals + i], keys[(level + 1) * nVals + i]);
+                encodeSymbol(enc, models, symbol, level);
+            }
+            if(node.hasChildren){
+                for(int r = 0; r < 2; ++r){
+                    for(int c = 0; c < 2; ++c){
+                        encode(*node.children[(1 - r) * 2 + c], level + 1);
+                    }
+                }
+            }
+        }
+    };
+
+    // checks that every node's extent is the quarter of its parent's extent
+    // that the decoder will give it (so that the extents don't have to be
+    // stored), and counts the nodes and leaves
+    void checkNode(const Quadtree &quadtree, const Node &node, int level, int64_t &nNodes, int64_t &nLeaves){
+        if(level > MAX_LEVEL) throw std::runtime_error("unable to write the quadtree in the compact format - the tree is too deep");
+        if(!quadtree.layers.empty() && (node.id < 0 || node.id >= quadtree.nNodes)) throw std::runtime_error("unable to write the quadtree - the node IDs don't match the number of nodes");
+        ++nNodes;
+        if(!node.hasChildren){
+            ++nLeaves;
+            return;
+        }
+        double xLength = (node.xMax - node.xMin) / 2;
+        double yLength = (node.yMax - node.yMin) / 2;
+        for(int r = 0; r < 2; ++r){
+            for(int c = 0; c < 2; ++c){
+                const Node &child = *node.children[(1 - r) * 2 + c];
+                double xMin = node.xMin + c * xLength;
+                double yMin = node.yMin + (1 - r) * yLength;
+                if(child.xMin != xMin || child.xMax != xMin + xLength || child.yMin != yMin || child.yMax != yMin + yLength){
+                    throw std::runtime_error("unable to write the quadtree in the compact format - the extents of the cells aren't the quarters of their parents' extents");
+                }
+                checkNode(quadtree, child, level + 1, nNodes, nLeaves);
+            }
+        }
+    }
+}
+
+// ------- isCompactFile -------
+// checks whether a file's header says that it was written in the compact
+// format
+bool CompactQuadtree::isCompactFile(const std::string &filePath){
+    return QuadtreeInfo::hasInfo(filePath) && QuadtreeInfo::read(filePath).format == QuadtreeInfo::Format::Compact;
+}
+
+// ------- readHeader -------
+CompactQuadtree::Header CompactQuadtree::readHeader(const std::string &filePath){
+    std::ifstream is(filePath, std::ios::binary);
+    if(!is) throw std::runtime_error("unable to open '" + filePath + "'");
+    is.seekg(dataOffset(filePath));
+    return readHeaderFrom(is, filePath);
+}
+
+// ------- readQuadtree -------
+// reads a quadtree from a compact file. The nodes are decoded while the file
+// is read, and the neighbors are found afterwards (like when reading a
+// 'cereal' file).
+std::shared_ptr<Quadtree> CompactQuadtree::readQuadtree(const std::string &filePath){
+    std::ifstream is(filePath, std::ios::binary);
+    if(!is) throw std::runtime_error("unable to open '" + filePath + "'");
+    is.seekg(dataOffset(filePath));
+    Header head = readHeaderFrom(is, filePath);
+    auto quadtree = std::make_shared<Quadtree>(head.xMin, head.xMax, head.yMin, head.yMax, head.matNX, head.matNY, head.projection,
+        head.maxXCellLength, head.maxYCellLength, head.minXCellLength, head.minYCellLength, head.splitAllNAs, head.splitAnyNAs);
+    RangeDecoder dec(is, filePath);
+    NodeDecoder decoder(dec, head, filePath);
+    quadtree->root = decoder.decode(head.xMin, head.xMax, head.yMin, head.yMax, 0);
+    if(decoder.nNodes() != head.nNodes) throw invalidFile(filePath, "the file has fewer nodes than the header says");
+    quadtree->nNodes = head.nNodes;
+    quadtree->valueType = head.valueType;
+    quadtree->activeLayer = head.activeLayer;
+    quadtree->layerNames = head.layerNames;
+    for(auto const &vals : decoder.layerVals){
+        quadtree->layers.push_back(std::make_shared<ValueVector>(head.valueType, vals));
+    }
+    quadtree->assignNeighbors();
+    return quadtree;
+}
+
+// ------- writeQuadtree -------
+// writes a quadtree in the compact format. 'original' contains the original
+// extent and dimensions (xMin, xMax, yMin, yMax, nX, nY) stored by
+// 'QuadtreeWrapper' - it can be empty. If 'precision' is greater than 0, the
+// values are rounded to the nearest multiple of it; otherwise they're stored
+// exactly. The nodes are written in preorder, so the IDs of the quadtree read
+// from the file are the ones 'Quadtree::assignIds()' would give.
+void CompactQuadtree::writeQuadtree(Quadtree &quadtree, const std::string &filePath, const std::vector<double> &original, double precision){
+    if(!(precision >= 0) || std::isinf(precision)) throw std::runtime_error("'precision' must be a non-negative number");
+    quadtree.syncActiveLayer();
+    // "int16" and "uint8" values are integers, so they can always be stored
+    // exactly as differences of integers
+    if(precision < 1 && (quadtree.valueType == ValueVector::Type::Int16 || quadtree.valueType == ValueVector::Type::UInt8)) precision = 1;
+
+    int64_t nNodes{0};
+    int64_t nLeaves{0};
+    checkNode(quadtree, *quadtree.root, 0, nNodes, nLeaves);
+    std::vector<std::vector<double>> layerVals;
+    for(int i = 0; i < static_cast<int>(quadtree.layers.size()); ++i){
+        if(quadtree.layers[i]->size() != static_cast<size_t>(quadtree.nNodes)) throw std::runtime_error("unable to write the quadtree - the number of values in a layer doesn't match the number of nodes");
+        layerVals.push_back(quadtree.layers[i]->asDoubles());
+    }
+
+    QuadtreeInfo info = QuadtreeInfo::fromQuadtree(quadtree, original, QuadtreeInfo::Format::Compact);
+    QuadtreeInfo::writeFile(filePath, info, [&](std::ostream &os){
+        os.write(MAGIC, sizeof(MAGIC));
+        putUInt(os, VERSION, 4);
+        putUInt(os, nNodes, 8);
+        putUInt(os, nLeaves, 8);
+        putUInt(os, quadtree.matNX, 4);
+        putUInt(os, quadtree.matNY, 4);
+        putUInt(os, quadtree.splitAllNAs, 1);
+        putUInt(os, quadtree.splitAnyNAs, 1);
+        putUInt(os, static_cast<int>(quadtree.valueType), 1);
+        putUInt(os, quadtree.layers.size(), 4);
+        putUInt(os, quadtree.activeLayer, 4);
+        putDouble(os, precision);
+        putDouble(os, quadtree.root->xMin);
+        putDouble(os, quadtree.root->xMax);
+        putDouble(os, quadtree.root->yMin);
+        putDouble(os, quadtree.root->yMax);
+        putDouble(os, quadtree.maxXCellLength);
+        putDouble(os, quadtree.maxYCellLength);
+        putDouble(os, quadtree.minXCellLength);
+        putDouble(os, quadtree.minYCellLength);
+        for(int i = 0; i < 6; ++i){
+            putDouble(os, original.size() == 6 ? original[i] : std::numeric_limits<double>::quiet_NaN());
+        }
+        putString(os, quadtree.projection);
+        for(size_t i = 0; i < quadtree.layers.size(); ++i){
+            putString(os, i < quadtree.layerNames.size() ? quadtree.layerNames[i] : "");
+        }
+
+        RangeEncoder enc(os);
+        NodeEncoder encoder(enc, quadtree, precision, layerVals);
+        encoder.encode(*quadtree.root, 0);
+        enc.finish();
+    });
+}
@@ -0,0 +1,72 @@
+#ifndef COMPACTQUADTREE_H
+#define COMPACTQUADTREE_H
+
+#include "Quadtree.h"
+#include "ValueVector.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// reads and writes quadtrees in the "compact" file format, which is meant for
+// archiving quadtrees. Most of what the other formats store for each node can
+// be derived from its parent - the extent is one quarter of the parent's
+// extent, the level is one more than the parent's, and the IDs are assigned in
+// preorder - so the compact format only stores the structure and the values.
+// These come after the header that every quadtree file starts with (see
+// 'QuadtreeInfo'):
+//
+//   header - the magic bytes, the version, and the information about the
+//      quadtree that isn't stored in the nodes (see 'CompactQuadtree::Header').
+//      All numbers are stored in little-endian byte order, so unlike the flat
+//      format the files can be read on any machine
+//   nodes - the nodes in preorder (the same order used by
+//      'Quadtree::assignIds()'). Each node is stored as one bit that says
+//      whether it has children, followed by its value in each layer
+//
+// Each value is stored as the difference from the parent's value (the root is
+// compared to 0). If 'precision' is 0, the values are stored exactly - the
+// difference is the XOR of the bits of the two values, which has leading
+// zero bytes when the values are close. Otherwise the values are rounded to a
+// multiple of 'precision' and the difference is the difference between the
+// integer multiples, which is stored as a zigzag-encoded integer (NA is stored
+// as 0). "int16" and "uint8" values are always stored as integers.
+//
+// The nodes are compressed with an adaptive binary range coder - the
+// probabilities used for a bit depend on the level of the node, and those
+// used for a byte of a difference depend on the position of the byte, so
+// parts of the tree with a regular structure and similar values take up very
+// little space. The nodes are decoded as the file is read, so reading a file
+// doesn't need more memory than the quadtree itself.
+class CompactQuadtree{
+public:
+    struct Header{
+        uint32_t version{0};
+        int64_t nNodes{0};
+        int64_t nLeaves{0};
+        int32_t matNX{0};
+        int32_t matNY{0};
+        bool splitAllNAs{false};
+        bool splitAnyNAs{true};
+        int32_t nLayers{0}; // 0 if the quadtree only has one layer
+        int32_t activeLayer{0};
+        ValueVector::Type valueType{ValueVector::Type::Double};
+        double precision{0}; // 0 if the values are stored exactly
+        double xMin{0}, xMax{0}, yMin{0}, yMax{0}; // extent of the root
+        double maxXCellLength{-1}, maxYCellLength{-1}, minXCellLength{-1}, minYCellLength{-1};
+        std::vector<double> original; // original extent and dimensions (xMin, xMax, yMin, yMax, nX, nY)
+        std::string projection;
+        std::vector<std::string> layerNames;
+    };
+
+    static const char MAGIC[8];
+    static const uint32_t VERSION;
+
+    static bool isCompactFile(const std::string &filePath);
+    static Header readHeader(const std::string &filePath);
+    static std::shared_ptr<Quadtree> readQuadtree(const std::string &filePath);
+    static void writeQuadtree(Quadtree &quadtree, const std::string &filePath, const std::vector<double> &original, double precision);
+};
+
+#endif
@@ -0,0 +1,625 @@
+#include "FlatQuadtree.h"
+
+#include "QuadtreeInfo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char FlatQuadtree::MAGIC[8] = {'Q', 'T', 'F', 'L', 'A', 'T', '\0', '\0'};
+const uint32_t FlatQuadtree::VERSION = 1;
+const int FlatQuadtree::BLOCK_NODES = 4096;
+
+namespace {
+    const uint32_t ENDIAN_CHECK = 0x01020304;
+
+    static_assert(sizeof(FlatQuadtree::Header) % 8 == 0, "the header must be a multiple of 8 bytes");
+    static_assert(sizeof(FlatQuadtree::FlatNode) == 72, "unexpected padding in 'FlatNode'");
+    static_assert(sizeof(FlatQuadtree::Block) == 40, "unexpected padding in 'Block'");
+
+    uint64_t align8(uint64_t offset){
+        return (offset + 7) / 8 * 8;
+    }
+
+    // writes 'n' bytes and then pads the file with zeros to a multiple of 8
+    void writeAligned(std::ostream &os, const void *bytes, uint64_t n){
+        if(n > 0) os.write(static_cast<const char*>(bytes), n);
+        static const char zeros[8] = {0};
+        os.write(zeros, align8(n) - n);
+    }
+
+    std::runtime_error invalidFile(const std::string &filePath, const std::string &reason){
+        return std::runtime_error("'" + filePath + "' is not a valid flat quadtree file: " + reason);
+    }
+
+    // throws an error if 'child' can't be a child of node 'id'. Since the IDs
+    // are in preorder, children always have larger IDs than their parents -
+    // this also guarantees that following child IDs can't loop forever.
+    void checkChild(int64_t id, int32_t child, int64_t nNodes){
+        if(child <= id || child >= nNodes) throw std::runtime_error("invalid child ID in flat quadtree file");
+    }
+
+    // throws an error if the neighbors of a node aren't within the neighbor
+    // IDs. 'end' is the number of neighbor IDs.
+    void checkNeighborOffsets(uint64_t first, uint64_t last, uint64_t end){
+        if(first > last || last > end) throw std::runtime_error("invalid neighbor offsets in flat quadtree file");
+    }
+
+    // returns the offset of the values of a layer
+    uint64_t layerOffset(const FlatQuadtree::Header &head, int layer){
+        return head.layersOffset + layer * align8(head.nNodes * ValueVector::typeSize(static_cast<ValueVector::Type>(head.valueType)));
+    }
+
+    // returns the offset of the flat data - i.e. the size of the
+    // 'QuadtreeInfo' header
+    uint64_t dataOffset(const std::string &filePath){
+        if(!QuadtreeInfo::hasInfo(filePath)) throw invalidFile(filePath, "unrecognized format");
+        QuadtreeInfo info = QuadtreeInfo::read(filePath);
+        if(info.format != QuadtreeInfo::Format::Flat) throw invalidFile(filePath, "it was written in the '" + QuadtreeInfo::formatToString(info.format) + "' format");
+        return info.headerSize;
+    }
+
+    // reads 'n' strings from the strings section, which starts at 'bytes' and
+    // has 'size' bytes
+    std::vector<std::string> readStrings(const char *bytes, uint64_t size, int n, const std::string &filePath){
+        std::vector<std::string> strings;
+        uint64_t offset{0};
+        for(int i = 0; i < n; ++i){
+            if(offset + sizeof(uint64_t) > size) throw invalidFile(filePath, "the file is truncated");
+            uint64_t length;
+            std::memcpy(&length, bytes + offset, sizeof(uint64_t));
+            offset += sizeof(uint64_t);
+            if(length > size - offset) throw invalidFile(filePath, "the file is truncated");
+            strings.push_back(std::string(bytes + offset, length));
+            offset = align8(offset + length);
+        }
+        return strings;
+    }
+}
+
+// ------- constructor -------
+// opens a flat quadtree file. Only the header and the strings are read - the
+// nodes and values are read from the mapped file when they're used.
+FlatQuadtree::FlatQuadtree(const std::string &filePath){
+    uint64_t offset = dataOffset(filePath);
+#ifndef _WIN32
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if(fd == -1) throw std::runtime_error("unable to open '" + filePath + "'");
+    struct stat info;
+    if(fstat(fd, &info) == -1){
+        close(fd);
+        throw std::runtime_error("unable to open '" + filePath + "'");
+    }
+    mappingSize = info.st_size;
+    if(mappingSize > 0){
+        void *mapped = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); // the mapping stays valid after the file is closed
+        if(mapped == MAP_FAILED) throw std::runtime_error("unable to map '" + filePath + "' into memory");
+        mapping = static_cast<const char*>(mapped);
+    } else {
+        close(fd);
+    }
+#else
+    std::ifstream is(filePath, std::ios::binary | std::ios::ate);
+    if(!is) throw std::runtime_error("unable to open '" + filePath + "'");
+    mappingSize = is.tellg();
+    buffer.resize(mappingSize);
+    is.seekg(0);
+    is.read(buffer.data(), mappingSize);
+    mapping = buffer.data();
+#endif
+
+    try{
+        if(mappingSize < offset + sizeof(Header)) throw invalidFile(filePath, "the file is truncated");
+        // the header size is a multiple of 8, so the sections are still aligned
+        data = mapping + offset;
+        size = mappingSize - offset;
+        head = reinterpret_cast<const Header*>(data);
+        checkHeader(*head, size, filePath);
+        uint64_t nNodes = head->nNodes;
+        nodes = reinterpret_cast<const FlatNode*>(data + head->nodesOffset);
+        neighborOffsets = reinterpret_cast<const uint64_t*>(data + head->neighborOffsetsOffset);
+        neighborIds = reinterpret_cast<const int32_t*>(data + head->neighborIdsOffset);
+        if(neighborOffsets[nNodes] > (head->layersOffset - head->neighborIdsOffset) / sizeof(int32_t)) throw invalidFile(filePath, "invalid section offsets");
+
+        for(int i = 0; i < head->nLayers; ++i){
+            layerData.push_back(data + layerOffset(*head, i));
+        }
+        strings = readStrings(data + head->stringsOffset, size - head->stringsOffset, head->nLayers + 1, filePath);
+    } catch(...){
+#ifndef _WIN32
+        if(mapping) munmap(const_cast<char*>(mapping), mappingSize);
+#endif
+        throw;
+    }
+}
+
+FlatQuadtree::~FlatQuadtree(){
+#ifndef _WIN32
+    if(mapping) munmap(const_cast<char*>(mapping), mappingSize);
+#endif
+}
+
+// ------- checkHeader -------
+// checks that the header and the sections are consistent with the file, so
+// that a truncated or corrupted file can't lead to reads outside of it.
+// 'dataSize' is the size of the file after the 'QuadtreeInfo' header. This
+// only covers the header - checking every node when a file is opened would
+// mean reading the whole file, so the child IDs and neighbor offsets are
+// checked as they're used instead (see 'checkChild()' and
+// 'checkNeighborOffsets()').
+void FlatQuadtree::checkHeader(const Header &head, uint64_t dataSize, const std::string &filePath){
+    if(std::memcmp(head.magic, MAGIC, sizeof(MAGIC)) != 0) throw invalidFile(filePath, "unrecognized format");
+    if(head.endianCheck != ENDIAN_CHECK) throw invalidFile(filePath, "it was written on a machine with a different byte order");
+    if(head.version != VERSION) throw invalidFile(filePath, "unsupported version (" + std::to_string(head.version) + ")");
+    if(head.dataSize != dataSize) throw invalidFile(filePath, "the file is truncated");
+    if(head.nNodes < 1 || head.nNodes > std::numeric_limits<int32_t>::max() || head.nLayers < 0 || head.nBlocks < 0 ||
+       head.activeLayer < 0 || head.activeLayer >= std::max(head.nLayers, 1) ||
+       head.valueType < 0 || head.valueType > static_cast<int32_t>(ValueVector::Type::UInt8)){
+        throw invalidFile(filePath, "invalid header");
+    }
+    // the counts come from the file, so multiplying them by the record sizes
+    // could overflow - instead, the space between the offsets is divided by
+    // the record size
+    auto fits = [](uint64_t begin, uint64_t end, uint64_t count, uint64_t recordSize){
+        return count <= (end - begin) / recordSize;
+    };
+    uint64_t nNodes = head.nNodes;
+    uint64_t layerSize = align8(nNodes * ValueVector::typeSize(static_cast<ValueVector::Type>(head.valueType))); // can't overflow, since 'nNodes' fits in an int32
+    if(head.nodesOffset < sizeof(Header) ||
+       head.neighborOffsetsOffset < head.nodesOffset || head.neighborIdsOffset < head.neighborOffsetsOffset ||
+       head.layersOffset < head.neighborIdsOffset || head.blocksOffset < head.layersOffset ||
+       head.stringsOffset < head.blocksOffset || dataSize < head.stringsOffset ||
+       !fits(head.nodesOffset, head.neighborOffsetsOffset, nNodes, sizeof(FlatNode)) ||
+       !fits(head.neighborOffsetsOffset, head.neighborIdsOffset, nNodes + 1, sizeof(uint64_t)) ||
+       !fits(head.layersOffset, head.blocksOffset, head.nLayers, layerSize) ||
+       !fits(head.blocksOffset, head.stringsOffset, head.nBlocks, sizeof(Block))){
+        throw invalidFile(filePath, "invalid section offsets");
+    }
+}
+
+// reads only the header of a file
+FlatQuadtree::Header FlatQuadtree::readHeader(const std::string &filePath){
+    uint64_t offset = dataOffset(filePath);
+    std::ifstream is(filePath, std::ios::binary | std::ios::ate);
+    if(!is) throw std::runtime_error("unable to open '" + filePath + "'");
+    uint64_t fileSize = is.tellg();
+    is.seekg(offset);
+    Header head;
+    if(!is.read(reinterpret_cast<char*>(&head), sizeof(Header))) throw invalidFile(filePath, "the file is truncated");
+    checkHeader(head, fileSize - offset, filePath);
+    return head;
+}
+
+const FlatQuadtree::Header& FlatQuadtree::header() const{
+    return *head;
+}
+
+const FlatQuadtree::FlatNode& FlatQuadtree::node(int id) const{
+    return nodes[id];
+}
+
+// ------- getNodeId -------
+// returns the ID of the leaf that contains the point, or -1 if the point is
+// outside the quadtree. This follows the same path as 'Quadtree::getNode()',
+// so only the nodes along the path are read from the file.
+int FlatQuadtree::getNodeId(const Point pt) const{
+    if(std::isnan(pt.x) || std::isnan(pt.y)) return -1;
+    int id{0};
+    while(true){
+        const FlatNode &flatNode = nodes[id];
+        if(pt.x < flatNode.xMin || pt.x > flatNode.xMax || pt.y < flatNode.yMin || pt.y > flatNode.yMax) return -1;
+        if(flatNode.children[0] == -1) return id;
+        int col = (pt.x < (flatNode.xMin + flatNode.xMax)/2) ? 0 : 1;
+        int row = (pt.y < (flatNode.yMin + flatNode.yMax)/2) ? 0 : 1;
+        int child = flatNode.children[row*2 + col];
+        checkChild(id, child, head->nNodes);
+        id = child;
+    }
+}
+
+// returns the value of a node in a (zero-based) layer
+double FlatQuadtree::getLayerValue(int id, int layer) const{
+    int nLayers = head->nLayers == 0 ? 1 : head->nLayers;
+    if(layer < 0 || layer >= nLayers){
+        throw std::runtime_error("invalid layer: " + std::to_string(layer) + " - the quadtree has " + std::to_string(nLayers) + " layer(s)");
+    }
+    if(layer == head->activeLayer) return nodes[id].value;
+    return ValueVector::get(static_cast<ValueVector::Type>(head->valueType), layerData[layer], id);
+}
+
+std::string FlatQuadtree::getProjection() const{
+    return strings[0];
+}
+
+std::vector<std::string> FlatQuadtree::getLayerNames() const{
+    return std::vector<std::string>(strings.begin() + 1, strings.end());
+}
+
+// ------- toQuadtree -------
+// creates a regular (modifiable) quadtree from the file. The neighbors are
+// stored in the file, so unlike when reading a 'cereal' file they don't have
+// to be recalculated.
+std::shared_ptr<Quadtree> FlatQuadtree::toQuadtree() const{
+    auto quadtree = std::make_shared<Quadtree>(head->xMin, head->xMax, head->yMin, head->yMax, head->matNX, head->matNY, getProjection(),
+        head->maxXCellLength, head->maxYCellLength, head->minXCellLength, head->minYCellLength, head->splitAllNAs, head->splitAnyNAs);
+    std::vector<std::shared_ptr<Node>> all(head->nNodes);
+    for(int64_t i = 0; i < head->nNodes; ++i){
+        const FlatNode &flatNode = nodes[i];
+        all[i] = std::make_shared<Node>(flatNode.xMin, flatNode.xMax, flatNode.yMin, flatNode.yMax, flatNode.value, i, flatNode.level,
+            flatNode.smallestChildSideLength, flatNode.children[0] != -1);
+    }
+    for(int64_t i = 0; i < head->nNodes; ++i){
+        const FlatNode &flatNode = nodes[i];
+        if(flatNode.children[0] != -1){
+            for(int j = 0; j < 4; ++j){
+                checkChild(i, flatNode.children[j], head->nNodes);
+                all[i]->children[j] = all[flatNode.children[j]];
+            }
+        }
+        checkNeighborOffsets(neighborOffsets[i], neighborOffsets[i + 1], neighborOffsets[head->nNodes]);
+        all[i]->neighbors.reserve(neighborOffsets[i + 1] - neighborOffsets[i]);
+        for(uint64_t j = neighborOffsets[i]; j < neighborOffsets[i + 1]; ++j){
+            if(neighborIds[j] < 0 || neighborIds[j] >= head->nNodes) throw std::runtime_error("invalid neighbor ID in flat quadtree file");
+            all[i]->neighbors.push_back(all[neighborIds[j]]);
+        }
+    }
+    quadtree->root = all[0];
+    quadtree->nNodes = head->nNodes;
+    quadtree->valueType = static_cast<ValueVector::Type>(head->valueType);
+    quadtree->activeLayer = head->activeLayer;
+    quadtree->layerNames = getLayerNames();
+    for(const char *layer : layerData){
+        quadtree->layers.push_back(std::make_shared<ValueVector>(quadtree->valueType, layer, head->nNodes));
+    }
+    return quadtree;
+}
+
+// ------- readWindow -------
+// reads the part of a quadtree that overlaps a rectangle. Only the blocks that
+// overlap the rectangle (and the ancestors of the blocks) are read from the
+// file. Each block that doesn't overlap the rectangle is replaced by a single
+// leaf with a value of NaN, so the quadtree still covers the same extent. The
+// node IDs are reassigned so that they're consecutive.
+std::shared_ptr<Quadtree> FlatQuadtree::readWindow(const std::string &filePath, double xMin, double xMax, double yMin, double yMax){
+    Header head = readHeader(filePath);
+    uint64_t base = dataOffset(filePath);
+    std::ifstream is(filePath, std::ios::binary);
+    auto readAt = [&](uint64_t offset, void *bytes, uint64_t n){
+        is.seekg(base + offset);
+        if(n > 0 && !is.read(static_cast<char*>(bytes), n)) throw invalidFile(filePath, "the file is truncated");
+    };
+
+    std::vector<Block> blocks(head.nBlocks);
+    readAt(head.blocksOffset, blocks.data(), blocks.size() * sizeof(Block));
+    std::vector<char> stringBytes(head.dataSize - head.stringsOffset);
+    readAt(head.stringsOffset, stringBytes.data(), stringBytes.size());
+    std::vector<std::string> strings = readStrings(stringBytes.data(), stringBytes.size(), head.nLayers + 1, filePath);
+
+    // find the ranges of IDs to read. The nodes between the blocks are always
+    // read, since they're the ancestors of the blocks.
+    std::vector<std::pair<int, int>> ranges;
+    auto addRange = [&](int first, int end){
+        if(first >= end) return;
+        if(!ranges.empty() && ranges.back().second == first){
+            ranges.back().second = end;
+        } else {
+            ranges.push_back({first, end});
+        }
+    };
+    std::vector<bool> skipped(blocks.size(), false);
+    int next{0};
+    for(size_t i = 0; i < blocks.size(); ++i){
+        const Block &block = blocks[i];
+        if(block.firstId < next || block.endId <= block.firstId || block.endId > head.nNodes) throw invalidFile(filePath, "invalid block index");
+        addRange(next, block.firstId);
+        if(block.xMin <= xMax && block.xMax >= xMin && block.yMin <= yMax && block.yMax >= yMin){
+            addRange(block.firstId, block.endId);
+        } else {
+            skipped[i] = true;
+        }
+        next = block.endId;
+    }
+    addRange(next, head.nNodes);
+
+    // the nodes that are read are stored consecutively - 'rangeStarts[i]' is
+    // the index of the first node of range 'i'
+    std::vector<int> rangeStarts{0};
+    for(auto const &range : ranges){
+        rangeStarts.push_back(rangeStarts.back() + range.second - range.first);
+    }
+    auto getIndex = [&](int id){ // returns -1 if the node wasn't read
+        auto range = std::upper_bound(ranges.begin(), ranges.end(), std::make_pair(id, std::numeric_limits<int>::max()));
+        if(range == ranges.begin() || id >= (--range)->second) return -1;
+        return rangeStarts[range - ranges.begin()] + id - range->first;
+    };
+    auto getBlock = [&](int id){ // returns -1 if the node isn't in a block
+        auto block = std::upper_bound(blocks.begin(), blocks.end(), id, [](int id, const Block &b){ return id < b.firstId; });
+        if(block == blocks.begin() || id >= (--block)->endId) return -1;
+        return static_cast<int>(block - blocks.begin());
+    };
+
+    // read the nodes, the values of the layers, and the neighbors in each
+    // range
+    ValueVector::Type type = static_cast<ValueVector::Type>(head.valueType);
+    int nLayers = head.nLayers;
+    std::vector<FlatNode> flatNodes(rangeStarts.back());
+    std::vector<std::vector<double>> layerVals(nLayers);
+    std::vector<uint64_t> neighborOffsets{0};
+    std::vector<int32_t> neighborIds;
+    std::vector<char> bytes;
+    std::vector<uint64_t> offsets;
+    for(size_t i = 0; i < ranges.size(); ++i){
+        int first = ranges[i].first;
+        int n = ranges[i].second - first;
+        readAt(head.nodesOffset + first * sizeof(FlatNode), flatNodes.data() + rangeStarts[i], n * sizeof(FlatNode));
+        for(int layer = 0; layer < nLayers; ++layer){
+            if(layer == head.activeLayer) continue; // the node values are the values of the active layer
+            bytes.resize(n * ValueVector::typeSize(type));
+            readAt(layerOffset(head, layer) + first * ValueVector::typeSize(type), bytes.data(), bytes.size());
+            for(int j = 0; j < n; ++j){
+                layerVals[layer].push_back(ValueVector::get(type, bytes.data(), j));
+            }
+        }
+        offsets.resize(n + 1);
+        readAt(head.neighborOffsetsOffset + first * sizeof(uint64_t), offsets.data(), offsets.size() * sizeof(uint64_t));
+        if(offsets[n] < offsets[0] || offsets[n] > (head.layersOffset - head.neighborIdsOffset) / sizeof(int32_t)) throw invalidFile(filePath, "invalid neighbor offsets");
+        neighborIds.resize(neighborIds.size() + offsets[n] - offsets[0]);
+        readAt(head.neighborIdsOffset + offsets[0] * sizeof(int32_t), neighborIds.data() + neighborIds.size() - (offsets[n] - offsets[0]), (offsets[n] - offsets[0]) * sizeof(int32_t));
+        for(int j = 1; j <= n; ++j){
+            if(offsets[j] < offsets[j - 1]) throw invalidFile(filePath, "invalid neighbor offsets");
+            neighborOffsets.push_back(neighborOffsets.back() + offsets[j] - offsets[j - 1]);
+        }
+    }
+    if(nLayers > 0){
+        for(auto const &flatNode : flatNodes){
+            layerVals[head.activeLayer].push_back(flatNode.value);
+        }
+    }
+
+    // create the nodes. Until the IDs are reassigned, the ID of each node is
+    // its ID in the file, or -1 for the leaves that replace skipped blocks.
+    std::vector<std::shared_ptr<Node>> nodes(flatNodes.size());
+    std::vector<std::shared_ptr<Node>> blockLeaves(blocks.size());
+    for(size_t i = 0; i < ranges.size(); ++i){
+        for(int id = ranges[i].first; id < ranges[i].second; ++id){
+            const FlatNode &flatNode = flatNodes[rangeStarts[i] + id - ranges[i].first];
+            nodes[rangeStarts[i] + id - ranges[i].first] = std::make_shared<Node>(flatNode.xMin, flatNode.xMax, flatNode.yMin, flatNode.yMax, flatNode.value, id, flatNode.level,
+                flatNode.smallestChildSideLength, flatNode.children[0] != -1);
+        }
+    }
+    auto getNode = [&](int id, int level){
+        int index = getIndex(id);
+        if(index != -1) return nodes[index];
+        int block = getBlock(id);
+        if(block == -1 || blocks[block].firstId != id) throw invalidFile(filePath, "invalid child ID");
+        const Block &b = blocks[block];
+        blockLeaves[block] = std::make_shared<Node>(b.xMin, b.xMax, b.yMin, b.yMax, std::numeric_limits<double>::quiet_NaN(), -1, level);
+        return blockLeaves[block];
+    };
+    for(size_t i = 0; i < flatNodes.size(); ++i){
+        if(flatNodes[i].children[0] == -1) continue;
+        for(int j = 0; j < 4; ++j){
+            checkChild(nodes[i]->id, flatNodes[i].children[j], head.nNodes);
+            nodes[i]->children[j] = getNode(flatNodes[i].children[j], flatNodes[i].level + 1);
+        }
+    }
+    std::shared_ptr<Node> root = getNode(0, 0);
+
+    // reassign the IDs (in the same order as 'Quadtree::assignIds()') and get
+    // the layer values of each node
+    std::vector<Node*> order;
+    std::vector<Node*> stack{root.get()};
+    while(!stack.empty()){
+        Node *node = stack.back();
+        stack.pop_back();
+        order.push_back(node);
+        if(node->hasChildren){
+            stack.insert(stack.end(), {node->children[1].get(), node->children[0].get(), node->children[3].get(), node->children[2].get()});
+        }
+    }
+    std::vector<std::vector<double>> vals(nLayers, std::vector<double>(order.size(), std::numeric_limits<double>::quiet_NaN()));
+    for(size_t i = 0; i < order.size(); ++i){
+        if(order[i]->id != -1){
+            int index = getIndex(order[i]->id);
+            for(int layer = 0; layer < nLayers; ++layer){
+                vals[layer][i] = layerVals[layer][index];
+            }
+        }
+        order[i]->id = i;
+    }
+    // the smallest cell may have been in a block that was skipped
+    for(size_t i = order.size(); i-- > 0;){
+        Node *node = order[i];
+        node->smallestChildSideLength = node->xMax - node->xMin;
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                node->smallestChildSideLength = std::min(node->smallestChildSideLength, child->smallestChildSideLength);
+            }
+        }
+    }
+
+    auto quadtree = std::make_shared<Quadtree>(head.xMin, head.xMax, head.yMin, head.yMax, head.matNX, head.matNY, strings[0],
+        head.maxXCellLength, head.maxYCellLength, head.minXCellLength, head.minYCellLength, head.splitAllNAs, head.splitAnyNAs);
+    quadtree->root = root;
+    quadtree->nNodes = order.size();
+    quadtree->valueType = type;
+    quadtree->activeLayer = head.activeLayer;
+    quadtree->layerNames = std::vector<std::string>(strings.begin() + 1, strings.end());
+    for(auto const &layer : vals){
+        quadtree->layers.push_back(std::make_shared<ValueVector>(type, layer));
+    }
+
+    // the neighbors of the nodes that were read come from the file, except
+    // that neighbors in skipped blocks are replaced by the leaf that replaced
+    // the block. The neighbors of those leaves have to be found.
+    for(size_t i = 0; i < nodes.size(); ++i){
+        auto &neighbors = nodes[i]->neighbors;
+        for(uint64_t j = neighborOffsets[i]; j < neighborOffsets[i + 1]; ++j){
+            if(neighborIds[j] < 0 || neighborIds[j] >= head.nNodes) throw invalidFile(filePath, "invalid neighbor ID");
+            int index = getIndex(neighborIds[j]);
+            if(index != -1){
+                neighbors.push_back(nodes[index]);
+            } else {
+                int block = getBlock(neighborIds[j]);
+                if(block == -1 || !blockLeaves[block]) throw invalidFile(filePath, "invalid neighbor ID");
+                if(std::none_of(neighbors.begin(), neighbors.end(), [&](const std::weak_ptr<Node> &nb){ return nb.lock() == blockLeaves[block]; })){
+                    neighbors.push_back(blockLeaves[block]);
+                }
+            }
+        }
+    }
+    for(auto const &leaf : blockLeaves){
+        if(!leaf) continue;
+        for(auto const &neighbor : quadtree->findNeighbors(leaf, root->smallestChildSideLength)){
+            leaf->neighbors.push_back(neighbor);
+        }
+    }
+    return quadtree;
+}
+
+// ------- isFlatFile -------
+// checks whether a file's header says that it was written in the flat format
+bool FlatQuadtree::isFlatFile(const std::string &filePath){
+    return QuadtreeInfo::hasInfo(filePath) && QuadtreeInfo::read(filePath).format == QuadtreeInfo::Format::Flat;
+}
+
+// ------- writeQuadtree -------
+// writes a quadtree in the flat format. 'original' contains the original
+// extent and dimensions (xMin, xMax, yMin, yMax, nX, nY) stored by
+// 'QuadtreeWrapper' - it can be empty.
+void FlatQuadtree::writeQuadtree(Quadtree &quadtree, const std::string &filePath, const std::vector<double> &original){
+    quadtree.syncActiveLayer();
+    int nNodes = quadtree.nNodes;
+
+    // the nodes, indexed by ID
+    std::vector<FlatNode> flatNodes(nNodes);
+    std::vector<const Node*> byId(nNodes, nullptr);
+    int64_t nLeaves{0};
+    std::vector<const Node*> stack{quadtree.root.get()};
+    while(!stack.empty()){
+        const Node *node = stack.back();
+        stack.pop_back();
+        if(node->id < 0 || node->id >= nNodes || byId[node->id]) throw std::runtime_error("unable to write the quadtree - the node IDs aren't unique or don't match the number of nodes");
+        byId[node->id] = node;
+        FlatNode &flatNode = flatNodes[node->id];
+        flatNode = FlatNode{node->xMin, node->xMax, node->yMin, node->yMax, node->value, node->smallestChildSideLength, {-1, -1, -1, -1}, node->level, node->id + 1};
+        if(node->hasChildren){
+            for(int i = 0; i < 4; ++i){
+                flatNode.children[i] = node->children[i]->id;
+                stack.push_back(node->children[i].get());
+            }
+        } else {
+            ++nLeaves;
+        }
+    }
+    if(std::find(byId.begin(), byId.end(), nullptr) != byId.end()) throw std::runtime_error("unable to write the quadtree - the node IDs don't match the number of nodes");
+    // since the IDs are in preorder, every descendant has a larger ID than its
+    // ancestors, so going backwards finishes each subtree before its parent
+    for(int i = nNodes - 1; i >= 0; --i){
+        for(int child : flatNodes[i].children){
+            if(child != -1 && flatNodes[child].subtreeEnd > flatNodes[i].subtreeEnd) flatNodes[i].subtreeEnd = flatNodes[child].subtreeEnd;
+        }
+    }
+
+    // the neighbors, in compressed sparse row format
+    std::vector<uint64_t> neighborOffsets(nNodes + 1, 0);
+    std::vector<int32_t> neighborIds;
+    for(int i = 0; i < nNodes; ++i){
+        for(auto &neighbor : byId[i]->neighbors){
+            if(auto ptr = neighbor.lock()) neighborIds.push_back(ptr->id);
+        }
+        neighborOffsets[i + 1] = neighborIds.size();
+    }
+
+    // the blocks - the largest subtrees with at most 'BLOCK_NODES' nodes
+    std::vector<Block> blocks;
+    std::vector<int> ids{0};
+    while(!ids.empty()){
+        const FlatNode &flatNode = flatNodes[ids.back()];
+        int id = ids.back();
+        ids.pop_back();
+        if(flatNode.subtreeEnd - id <= BLOCK_NODES){
+            blocks.push_back(Block{flatNode.xMin, flatNode.xMax, flatNode.yMin, flatNode.yMax, id, flatNode.subtreeEnd});
+        } else {
+            ids.insert(ids.end(), flatNode.children, flatNode.children + 4);
+        }
+    }
+    std::sort(blocks.begin(), blocks.end(), [](const Block &a, const Block &b){ return a.firstId < b.firstId; });
+
+    std::vector<std::string> strs{quadtree.projection};
+    strs.insert(strs.end(), quadtree.layerNames.begin(), quadtree.layerNames.end());
+
+    Header head;
+    std::memset(&head, 0, sizeof(Header));
+    std::memcpy(head.magic, MAGIC, sizeof(MAGIC));
+    head.version = VERSION;
+    head.endianCheck = ENDIAN_CHECK;
+    head.nNodes = nNodes;
+    head.nLeaves = nLeaves;
+    head.matNX = quadtree.matNX;
+    head.matNY = quadtree.matNY;
+    head.splitAllNAs = quadtree.splitAllNAs;
+    head.splitAnyNAs = quadtree.splitAnyNAs;
+    head.nLayers = quadtree.layers.size();
+    head.activeLayer = quadtree.activeLayer;
+    head.valueType = static_cast<int32_t>(quadtree.valueType);
+    head.xMin = quadtree.root->xMin;
+    head.xMax = quadtree.root->xMax;
+    head.yMin = quadtree.root->yMin;
+    head.yMax = quadtree.root->yMax;
+    head.maxXCellLength = quadtree.maxXCellLength;
+    head.maxYCellLength = quadtree.maxYCellLength;
+    head.minXCellLength = quadtree.minXCellLength;
+    head.minYCellLength = quadtree.minYCellLength;
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    head.originalXMin = original.size() == 6 ? original[0] : nan;
+    head.originalXMax = original.size() == 6 ? original[1] : nan;
+    head.originalYMin = original.size() == 6 ? original[2] : nan;
+    head.originalYMax = original.size() == 6 ? original[3] : nan;
+    head.originalNX = original.size() == 6 ? original[4] : nan;
+    head.originalNY = original.size() == 6 ? original[5] : nan;
+
+    head.nodesOffset = sizeof(Header);
+    head.neighborOffsetsOffset = align8(head.nodesOffset + flatNodes.size() * sizeof(FlatNode));
+    head.neighborIdsOffset = align8(head.neighborOffsetsOffset + neighborOffsets.size() * sizeof(uint64_t));
+    head.layersOffset = align8(head.neighborIdsOffset + neighborIds.size() * sizeof(int32_t));
+    for(auto const &layer : quadtree.layers){
+        if(layer->size() != static_cast<size_t>(nNodes)) throw std::runtime_error("unable to write the quadtree - the number of values in a layer doesn't match the number of nodes");
+    }
+    head.blocksOffset = layerOffset(head, head.nLayers);
+    head.nBlocks = blocks.size();
+    head.stringsOffset = align8(head.blocksOffset + blocks.size() * sizeof(Block));
+    head.dataSize = head.stringsOffset;
+    for(auto const &str : strs){
+        head.dataSize = align8(head.dataSize + sizeof(uint64_t) + str.size());
+    }
+
+    QuadtreeInfo info = QuadtreeInfo::fromQuadtree(quadtree, original, QuadtreeInfo::Format::Flat);
+    QuadtreeInfo::writeFile(filePath, info, [&](std::ostream &os){
+        writeAligned(os, &head, sizeof(Header));
+        writeAligned(os, flatNodes.data(), flatNodes.size() * sizeof(FlatNode));
+        writeAligned(os, neighborOffsets.data(), neighborOffsets.size() * sizeof(uint64_t));
+        writeAligned(os, neighborIds.data(), neighborIds.size() * sizeof(int32_t));
+        for(auto const &layer : quadtree.layers){
+            writeAligned(os, layer->bytes(), nNodes * ValueVector::typeSize(quadtree.valueType));
+        }
+        writeAligned(os, blocks.data(), blocks.size() * sizeof(Block));
+        for(auto const &str : strs){
+            uint64_t length = str.size();
+            os.write(reinterpret_cast<const char*>(&length), sizeof(uint64_t));
+            writeAligned(os, str.data(), length);
+        }
+    });
+}
@@ -0,0 +1,131 @@
+#ifndef FLATQUADTREE_H
+#define FLATQUADTREE_H
+
+#include "Point.h"
+#include "Quadtree.h"
+#include "ValueVector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// read-only quadtree stored in the "flat" file format. Unlike the 'cereal'
+// format (which stores the nested nodes and has to rebuild every node and the
+// neighbor relationships when it's read), the flat format stores the tree as
+// a few contiguous arrays that can be used directly from the file. These come
+// after the header that every quadtree file starts with (see 'QuadtreeInfo'),
+// and all of the offsets are relative to the end of that header:
+//
+//   header - fixed size, see 'FlatQuadtree::Header'
+//   nodes - one 'FlatNode' per node, indexed by node ID (i.e. in preorder)
+//   neighbor offsets - nNodes + 1 uint64s. The neighbors of node 'i' are at
+//      [offsets[i], offsets[i + 1]) in the neighbor IDs
+//   neighbor IDs - int32s
+//   layers - one array per layer (if the quadtree has more than one layer),
+//      using the bytes of the value type (see 'ValueVector')
+//   blocks - one 'Block' per block, in order of ID (see below)
+//   strings - the projection, then the layer names. Each is stored as a
+//      uint64 length followed by the characters
+//
+// Every section starts at a multiple of 8 bytes. Numbers are stored in the
+// byte order of the machine that wrote the file - 'endianCheck' is used to
+// detect files from machines with a different byte order.
+//
+// The file is opened with 'mmap()' (on Windows it's read into memory
+// instead), so opening a file only reads the header, and pages of the file
+// are only read from disk when they're used. Since the mapping is read-only
+// and shared, several processes that open the same file share a single copy
+// of it in the page cache.
+//
+// Since the nodes are in preorder, every subtree is stored in a contiguous
+// range of IDs. The file is split into "blocks" - the largest subtrees that
+// have at most 'BLOCK_NODES' nodes - and the extent and ID range of each block
+// is stored in the block index. The nodes that aren't in a block are the
+// ancestors of the blocks, and there are few of them. This lets
+// 'readWindow()' read only the blocks that overlap an area.
+class FlatQuadtree{
+public:
+    struct Header{
+        char magic[8];
+        uint32_t version;
+        uint32_t endianCheck;
+        int64_t nNodes;
+        int64_t nLeaves;
+        int32_t matNX;
+        int32_t matNY;
+        int32_t splitAllNAs;
+        int32_t splitAnyNAs;
+        int32_t nLayers; // 0 if the quadtree only has one layer
+        int32_t activeLayer;
+        int32_t valueType;
+        int32_t padding;
+        double xMin, xMax, yMin, yMax; // extent of the root
+        double maxXCellLength, maxYCellLength, minXCellLength, minYCellLength;
+        double originalXMin, originalXMax, originalYMin, originalYMax, originalNX, originalNY;
+        uint64_t nodesOffset;
+        uint64_t neighborOffsetsOffset;
+        uint64_t neighborIdsOffset;
+        uint64_t layersOffset;
+        uint64_t blocksOffset;
+        int64_t nBlocks;
+        uint64_t stringsOffset;
+        uint64_t dataSize; // size of the flat data (i.e. the file without the 'QuadtreeInfo' header)
+    };
+
+    struct FlatNode{
+        double xMin, xMax, yMin, yMax;
+        double value; // value of the active layer
+        double smallestChildSideLength;
+        int32_t children[4]; // IDs of the children (same order as 'Node::children') - -1 if the node has no children
+        int32_t level;
+        int32_t subtreeEnd; // one more than the largest ID in the node's subtree
+    };
+
+    struct Block{
+        double xMin, xMax, yMin, yMax; // extent of the root of the block
+        int32_t firstId; // ID of the root of the block
+        int32_t endId; // one more than the largest ID in the block
+    };
+
+    static const char MAGIC[8];
+    static const uint32_t VERSION;
+    static const int BLOCK_NODES;
+
+    FlatQuadtree(const std::string &filePath);
+    ~FlatQuadtree();
+    FlatQuadtree(const FlatQuadtree&) = delete;
+    FlatQuadtree& operator=(const FlatQuadtree&) = delete;
+
+    const Header& header() const;
+    const FlatNode& node(int id) const;
+    int getNodeId(const Point pt) const;
+    double getLayerValue(int id, int layer) const;
+    std::string getProjection() const;
+    std::vector<std::string> getLayerNames() const;
+
+    std::shared_ptr<Quadtree> toQuadtree() const;
+
+    static void checkHeader(const Header &head, uint64_t dataSize, const std::string &filePath);
+    static Header readHeader(const std::string &filePath);
+    static std::shared_ptr<Quadtree> readWindow(const std::string &filePath, double xMin, double xMax, double yMin, double yMax);
+    static bool isFlatFile(const std::string &filePath);
+    static void writeQuadtree(Quadtree &quadtree, const std::string &filePath, const std::vector<double> &original);
+
+private:
+    const char *mapping{nullptr}; // start of the file
+    size_t mappingSize{0};
+    std::vector<char> buffer; // only used if the file couldn't be mapped
+    const char *data{nullptr}; // start of the flat data
+    size_t size{0};
+
+    const Header *head{nullptr};
+    const FlatNode *nodes{nullptr};
+    const uint64_t *neighborOffsets{nullptr};
+    const int32_t *neighborIds{nullptr};
+    std::vector<const char*> layerData;
+    std::vector<std::string> strings;
+};
+
+#endif
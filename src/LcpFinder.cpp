@@ -1,7 +1,10 @@
 #include "LcpFinder.h"
 
+#include "Parallel.h"
+
 #include <cmath>
 #include <algorithm>
+#include <limits>
 
 // ------- constructors -------
 LcpFinder::LcpFinder()
@@ -83,38 +86,70 @@ void LcpFinder::makeNodePointMap(std::vector<Point> newPoints){
 }
 
 // ------- init -------
-// sets up the empty network we'll use when finding LCPs. Creates a 'NodeEdge' for each node, but
-// leaves the parent, dist, cost, and nNodesFromOrigin fields blank, to be filled in when the 
-// algorithm runs.
+// sets up the empty network we'll use when finding LCPs. NodeEdges aren't
+// created up front - a NodeEdge is only created for a node once the algorithm
+// reaches it (see 'getNodeEdgeIndex()'), so setting things up doesn't depend
+// on the size of the search area. The parent, dist, cost, and nNodesFromOrigin
+// fields of the NodeEdges are filled in when the algorithm runs.
 void LcpFinder::init(int startNodeID){
-    std::list<std::shared_ptr<Node>> nodes = quadtree->getNodesInBox(xMin, xMax, yMin, yMax, includeNodesByCentroid); // get all nodes in the search area
-    nodeEdges = std::vector<std::shared_ptr<NodeEdge>>(nodes.size());
-    
-    dict = std::map<int, int>(); // dictionary with Node ID's as the key and the index of the corresponding 'NodeEdge' in 'nodeEdges'
+    nodeEdges = std::vector<std::shared_ptr<NodeEdge>>();
+    dict.clear(); // dictionary with Node ID's as the key and the index of the corresponding 'NodeEdge' in 'nodeEdges'
     possibleEdges = std::multiset<std::tuple<int,int,double,double>, cmp>();
-    if(nodes.size() > 0){ // only continue if there's at least one node in the search area
-        int i{0};
-        for(auto iNode : nodes){ // loop over each node and create a 'NodeEdge' for each node
-            Point pt((iNode->xMin + iNode->xMax)/2, (iNode->yMin + iNode->yMax)/2);
-            NodeEdge *ne = new NodeEdge{i, std::weak_ptr<Node>(iNode), pt, std::weak_ptr<NodeEdge>(),0,0,0};
-            nodeEdges.at(i) = std::shared_ptr<NodeEdge>(ne);
-            dict[nodeEdges.at(i)->node.lock()->id] = i; 
-            if(iNode->id == startNodeID){ // check if this node is the same as 'startNode'
-                if(!std::isnan(iNode->value)){ // if the starting node is NA, don't add it
-                    possibleEdges.insert(std::make_tuple(i, i, 0, 0)); // initialize our set with the start node
-                }
-            }
-            i++;
-        }
-        // if specified by the user, associate nodes with the user-provided points
-        for(auto const& x : nodePointMap){
-            if(dict.find(x.first) != dict.end()){
-                nodeEdges[dict[x.first]]->pt = x.second;
-            }
+    std::shared_ptr<Node> node = quadtree->getNode(startNodeID);
+    if(node && !node->hasChildren && !std::isnan(node->value)){ // if the starting node is NA, don't add it
+        if(getNodeEdgeIndex(node) != -1){ // only continue if the start node is in the search area
+            possibleEdges.insert(std::make_tuple(startNodeID, startNodeID, 0, 0)); // initialize our set with the start node
         }
     }
 }
 
+// ------- isInSearchArea -------
+// checks whether a node falls in the search area. Uses the same criteria as
+// 'Quadtree::getNodesInBox()' - if 'includeNodesByCentroid' is true the
+// centroid has to be in the search area, otherwise any overlap is enough.
+bool LcpFinder::isInSearchArea(const Node &node) const{
+    if(includeNodesByCentroid){
+        double xCentroid = (node.xMin + node.xMax) / 2;
+        double yCentroid = (node.yMin + node.yMax) / 2;
+        return !(xCentroid < xMin || xCentroid > xMax || yCentroid < yMin || yCentroid > yMax);
+    }
+    return !(xMax < node.xMin || xMin > node.xMax) && !(yMax < node.yMin || yMin > node.yMax);
+}
+
+// ------- getNodeEdgeIndex -------
+// returns the index of the NodeEdge that represents 'node', creating the
+// NodeEdge if it doesn't exist yet. Returns -1 if the node falls outside the
+// search area.
+int LcpFinder::getNodeEdgeIndex(const std::shared_ptr<Node> &node){
+    int i = dict.get(node->id);
+    if(i != -1){
+        return i;
+    }
+    if(!isInSearchArea(*node)){
+        return -1;
+    }
+    i = nodeEdges.size();
+    Point pt((node->xMin + node->xMax)/2, (node->yMin + node->yMax)/2);
+    std::map<int, Point>::iterator ptItr = nodePointMap.find(node->id); // if specified by the user, associate the node with the user-provided point
+    if(ptItr != nodePointMap.end()){
+        pt = ptItr->second;
+    }
+    nodeEdges.push_back(std::make_shared<NodeEdge>(NodeEdge{i, std::weak_ptr<Node>(node), pt, std::weak_ptr<NodeEdge>(),0,0,0}));
+    dict.set(node->id, i);
+    return i;
+}
+
+// ------- makeAllNodeEdges -------
+// creates NodeEdges for all of the nodes in the search area that don't have
+// one yet. Only used by 'makeNetworkParallel()', which can't create NodeEdges
+// as it goes since it's multi-threaded.
+void LcpFinder::makeAllNodeEdges(){
+    std::list<std::shared_ptr<Node>> nodes = quadtree->getNodesInBox(xMin, xMax, yMin, yMax, includeNodesByCentroid);
+    for(auto iNode : nodes){
+        getNodeEdgeIndex(iNode);
+    }
+}
+
 
 // NOTE: this is the old doNextIteration() (before I added the ability to customize the points used
 // to represent the nodes). Leaving this here until I'm more confident that the new version is
@@ -204,6 +239,105 @@ void LcpFinder::init(int startNodeID){
 //     }
 // }
 
+// ------- getEdgeCost -------
+// calculates the cost and the length of the edge between two neighboring nodes.
+// This used to live inside 'doNextIteration()' - I pulled it out so that the
+// parallel version of the algorithm (see 'makeNetworkParallel()') uses the
+// exact same calculation. See the note above 'doNextIteration()' for details
+// on how the edge is constructed.
+// PARAMETERS:
+//   node, pt -> the node the edge starts in and the point used to represent it
+//   nodeNb, ptNb -> the neighboring node and the point used to represent it
+// RETURNS: a pair - the first element is the cost of the edge, the second is
+//   the length of the edge
+std::pair<double, double> LcpFinder::getEdgeCost(const Node &node, const Point &pt, const Node &nodeNb, const Point &ptNb){
+    // get cost for the path - to do that we need to know the length of the segment in each cell
+    // first, figure out which side the two cells are adjacent on - this'll give us one coordinate for the intersection point (whether we know the x or y depends on which side they're adjacent on)
+    // note that I was previously checking for equality between the x and y limits - but this was causing problems because we're comparing doubles, so in rare cases none of the equality checks were true. Instead, I'm now looking for the lowest difference between the sides 
+    std::vector<double> difs{
+        std::abs(node.xMin - nodeNb.xMax), // left side
+        std::abs(node.xMax - nodeNb.xMin), // right side
+        std::abs(node.yMin - nodeNb.yMax), // bottom
+        std::abs(node.yMax - nodeNb.yMin) // top
+    }; 
+    int minIndex = 0;
+    for(int i = 1; i < 4; ++i){
+        if(difs[i] < difs[minIndex]){
+            minIndex = i;
+        }
+    }
+
+    // NOTE: my guess is that there is a much more concise way of doing these calculations (probably using matrices or something). Right now it's kind of cumbersome - there's a lot of code replication going on. But now that I finally got it working I'm not feeling especially inspired to make it as elegant as possible - I doubt it would improve performance at all. So I'm not going to. Maybe someday (let's be honest, that means never).
+    double mid{0}; // this is the coordinate (x or y, depending on which side they are adjacent on) that represents the line along which the two nodes are adjacent
+    bool isX = true; // tells us whether mid coordinate is an x-coordinate or a y-coordinate
+
+    if(minIndex == 0){ // left side
+        mid = node.xMin;
+    } else if(minIndex == 1) { // right side
+        mid = node.xMax;
+    } else if(minIndex == 2) { // bottom
+        mid = node.yMin;
+        isX = false;
+    } else if(minIndex == 3) { // top
+        mid = node.yMax;
+        isX = false;
+    }
+    
+    // get the two "corners" where the two rectangles meet - these two coordinates define the segment of the "shared edge"
+    Point corner1(std::max(node.xMin, nodeNb.xMin), std::max(node.yMin, node.yMin));
+    Point corner2(std::min(node.xMax, nodeNb.xMax), std::min(node.yMax, nodeNb.yMax));
+    
+    // get the difference in the x and y coordinates
+    double deltaX = ptNb.x - pt.x;
+    double deltaY = ptNb.y - pt.y;
+    double ratio{0}; // this will be the proportion of the line that falls in the first node (as long as the line falls entirely within the two nodes)
+    Point midPoint; // this'll be point at which the line intersects the (vertical or horizontal) line represented by 'mid'
+    bool inside = true; // tells us whether the segment lies entirely within the two neighboring cells
+    // now get the ratio between: {the difference between the known (x or y) mid-coordinate and the (x or y) coordinate of the starting point} and {the difference in the (x or y) coordinates of the two centroids}
+    if(isX){
+        double x = mid;
+        ratio = (x - pt.x) / deltaX;
+        double y = pt.y + ratio * deltaY; // get the y coordinate of the intersection point
+        // x and y now define the place where the line intersects 'mid'. Now check if this intersection point lies on the 'shared edge' of the two nodes represented by the two 'corner' points. If not, set the new midpoint to be the closest corner point
+        if(y < corner1.y){
+            inside = false;
+            midPoint = Point(x, corner1.y);
+        } else if(y > corner2.y){
+            inside = false;
+            midPoint = Point(x, corner2.y);
+        }
+    } else {
+        double y = mid;
+        ratio = (y - pt.y) / deltaY;
+        double x = pt.x + ratio * deltaX;
+        if(x < corner1.x){
+            inside = false;
+            midPoint = Point(corner1.x, y);
+        } else if (x > corner2.x){
+            inside = false;
+            midPoint = Point(corner2.x, y);
+        }
+    }
+
+    // calculate the length of the segment in each node
+    double dist1;
+    double dist2;
+    if(inside){
+        // if the line falls w/in the two nodes, use the ratio we calculated to get the length of the segment in each cell
+        double dist = std::sqrt(std::pow(pt.x - ptNb.x, 2) + std::pow(pt.y - ptNb.y, 2));
+        dist1 = dist * ratio;
+        dist2 = dist - dist1;
+    } else {
+        // if the line goes outside the two nodes, calculate the distance from point 1 to the midpoint, and from the midpoint to point 2
+        dist1 = std::sqrt(std::pow(pt.x - midPoint.x, 2) + std::pow(pt.y - midPoint.y, 2));
+        dist2 = std::sqrt(std::pow(ptNb.x - midPoint.x, 2) + std::pow(ptNb.y - midPoint.y, 2));
+    }
+
+    // use those distances to get the cost, weighted by the length of the segment in each cell
+    double cost = dist1 * (node.value) + dist2 * (nodeNb.value);
+    return std::make_pair(cost, dist1 + dist2);
+}
+
 // ------- doNextIteration -------
 // performs one iteration of the shortest path algorithm
 // NOTE: 
@@ -226,113 +360,34 @@ void LcpFinder::init(int startNodeID){
 // returns -1 if no edge was added
 int LcpFinder::doNextIteration(){
     auto beginItr = possibleEdges.begin();
-    std::shared_ptr<NodeEdge> nodeEdge = nodeEdges.at(std::get<1>(*beginItr)); // get the edge that's at the front of the set
+    std::shared_ptr<NodeEdge> nodeEdge = nodeEdges.at(dict.get(std::get<1>(*beginItr))); // get the edge that's at the front of the set
     auto parent = nodeEdge->parent.lock();
     if(parent){ // if the destination node already has a pointer for parent, it's already been included, so we'll skip this one 
         possibleEdges.erase(beginItr); 
         return -1;
     } else { // otherwise we'll set the 'parent' property of the destination node and then add the additional edge possibilities that result    
-        nodeEdge->parent = std::weak_ptr<NodeEdge>(nodeEdges.at(std::get<0>(*beginItr))); // set the parent of the destination node to be the source node
-        nodeEdge->nNodesFromOrigin = nodeEdges.at(std::get<0>(*beginItr))->nNodesFromOrigin + 1; // add 1 to the number of nodes from the origin of the parent
+        std::shared_ptr<NodeEdge> nodeEdgeParent = nodeEdges.at(dict.get(std::get<0>(*beginItr)));
+        nodeEdge->parent = std::weak_ptr<NodeEdge>(nodeEdgeParent); // set the parent of the destination node to be the source node
+        nodeEdge->nNodesFromOrigin = nodeEdgeParent->nNodesFromOrigin + 1; // add 1 to the number of nodes from the origin of the parent
         nodeEdge->cost = std::get<2>(*beginItr); // assign the cost-distance to the NodeEdge
         nodeEdge->dist = std::get<3>(*beginItr); // assign the distance to the NodeEdge
         
         possibleEdges.erase(beginItr); // remove this edge from the list of possibilities
 
-        // now we'll add the edges corresponding to this node's neighbors
+        // now add the edges to the neighbors of this node
         auto node = nodeEdge->node.lock();
         for(size_t i = 0; i < node->neighbors.size(); ++i){ // loop over each of its neighbors
-            std::map<int,int>::iterator itr = dict.find(node->neighbors.at(i).lock()->id); // see if this neighbor is included in our dictionary - if not, then it must fall outside the extent
-            if(itr != dict.end()){
-                std::shared_ptr<NodeEdge> nodeEdgeNb = nodeEdges.at(itr->second);
-                auto nodeNb = nodeEdgeNb->node.lock();
-                if(!(nodeEdgeNb->parent.lock()) && !std::isnan(nodeNb->value)){ // check if this node already has a parent assigned i.e. has already been included in the network, or if this node is NAN
-                    // get cost for the path - to do that we need to know the length of the segment in each cell
-                    // first, figure out which side the two cells are adjacent on - this'll give us one coordinate for the intersection point (whether we know the x or y depends on which side they're adjacent on)
-                    // note that I was previously checking for equality between the x and y limits - but this was causing problems because we're comparing doubles, so in rare cases none of the equality checks were true. Instead, I'm now looking for the lowest difference between the sides 
-                    std::vector<double> difs{
-                        std::abs(node->xMin - nodeNb->xMax), // left side
-                        std::abs(node->xMax - nodeNb->xMin), // right side
-                        std::abs(node->yMin - nodeNb->yMax), // bottom
-                        std::abs(node->yMax - nodeNb->yMin) // top
-                    }; 
-                    int minIndex = 0;
-                    for(int i = 1; i < 4; ++i){
-                        if(difs[i] < difs[minIndex]){
-                            minIndex = i;
-                        }
+            auto nodeNb = node->neighbors.at(i).lock();
+            if(!std::isnan(nodeNb->value)){ // skip NA nodes - we don't bother making NodeEdges for them since they can never be reached
+                int iNb = getNodeEdgeIndex(nodeNb); // gets the NodeEdge for this neighbor, creating it if this is the first time we've come across it
+                if(iNb != -1){ // -1 means it falls outside the search area
+                    std::shared_ptr<NodeEdge> nodeEdgeNb = nodeEdges.at(iNb);
+                    if(!(nodeEdgeNb->parent.lock())){ // check if this node already has a parent assigned i.e. has already been included in the network
+                        std::pair<double, double> edgeCost = getEdgeCost(*node, nodeEdge->pt, *nodeNb, nodeEdgeNb->pt);
+                        double tot_cost = edgeCost.first + nodeEdge->cost; // add the cost of the edge to the cost to get to 'nodeEdge' to get the total cost from the origin
+                        double tot_dist = edgeCost.second + nodeEdge->dist;
+                        possibleEdges.insert(std::make_tuple(node->id, nodeNb->id, tot_cost, tot_dist));
                     }
-
-                    // NOTE: my guess is that there is a much more concise way of doing these calculations (probably using matrices or something). Right now it's kind of cumbersome - there's a lot of code replication going on. But now that I finally got it working I'm not feeling especially inspired to make it as elegant as possible - I doubt it would improve performance at all. So I'm not going to. Maybe someday (let's be honest, that means never).
-                    double mid{0}; // this is the coordinate (x or y, depending on which side they are adjacent on) that represents the line along which the two nodes are adjacent
-                    bool isX = true; // tells us whether mid coordinate is an x-coordinate or a y-coordinate
-
-                    if(minIndex == 0){ // left side
-                        mid = node->xMin;
-                    } else if(minIndex == 1) { // right side
-                        mid = node->xMax;
-                    } else if(minIndex == 2) { // bottom
-                        mid = node->yMin;
-                        isX = false;
-                    } else if(minIndex == 3) { // top
-                        mid = node->yMax;
-                        isX = false;
-                    }
-                    
-                    // get the two "corners" where the two rectangles meet - these two coordinates define the segment of the "shared edge"
-                    Point corner1(std::max(node->xMin, nodeNb->xMin), std::max(node->yMin, node->yMin));
-                    Point corner2(std::min(node->xMax, nodeNb->xMax), std::min(node->yMax, nodeNb->yMax));
-                    
-                    // get the difference in the x and y coordinates
-                    double deltaX = nodeEdgeNb->pt.x - nodeEdge->pt.x;
-                    double deltaY = nodeEdgeNb->pt.y - nodeEdge->pt.y;
-                    double ratio{0}; // this will be the proportion of the line that falls in the first node (as long as the line falls entirely within the two nodes)
-                    Point midPoint; // this'll be point at which the line intersects the (vertical or horizontal) line represented by 'mid'
-                    bool inside = true; // tells us whether the segment lies entirely within the two neighboring cells
-                    // now get the ratio between: {the difference between the known (x or y) mid-coordinate and the (x or y) coordinate of the starting point} and {the difference in the (x or y) coordinates of the two centroids}
-                    if(isX){
-                        double x = mid;
-                        ratio = (x - nodeEdge->pt.x) / deltaX;
-                        double y = nodeEdge->pt.y + ratio * deltaY; // get the y coordinate of the intersection point
-                        // x and y now define the place where the line intersects 'mid'. Now check if this intersection point lies on the 'shared edge' of the two nodes represented by the two 'corner' points. If not, set the new midpoint to be the closest corner point
-                        if(y < corner1.y){
-                            inside = false;
-                            midPoint = Point(x, corner1.y);
-                        } else if(y > corner2.y){
-                            inside = false;
-                            midPoint = Point(x, corner2.y);
-                        }
-                    } else {
-                        double y = mid;
-                        ratio = (y - nodeEdge->pt.y) / deltaY;
-                        double x = nodeEdge->pt.x + ratio * deltaX;
-                        if(x < corner1.x){
-                            inside = false;
-                            midPoint = Point(corner1.x, y);
-                        } else if (x > corner2.x){
-                            inside = false;
-                            midPoint = Point(corner2.x, y);
-                        }
-                    }
-
-                    // calculate the length of the segment in each node
-                    double dist1;
-                    double dist2;
-                    if(inside){
-                        // if the line falls w/in the two nodes, use the ratio we calculated to get the length of the segment in each cell
-                        double dist = std::sqrt(std::pow(nodeEdge->pt.x - nodeEdgeNb->pt.x, 2) + std::pow(nodeEdge->pt.y - nodeEdgeNb->pt.y, 2));
-                        dist1 = dist * ratio;
-                        dist2 = dist - dist1;
-                    } else {
-                        // if the line goes outside the two nodes, calculate the distance from point 1 to the midpoint, and from the midpoint to point 2
-                        dist1 = std::sqrt(std::pow(nodeEdge->pt.x - midPoint.x, 2) + std::pow(nodeEdge->pt.y - midPoint.y, 2));
-                        dist2 = std::sqrt(std::pow(nodeEdgeNb->pt.x - midPoint.x, 2) + std::pow(nodeEdgeNb->pt.y - midPoint.y, 2));
-                    }
-
-                    // use those distances to get the cost, weighted by the length of the segment in each cell. Add this to the cost to get to 'nodeEdge' to get the total cost from the origin
-                    double tot_cost = dist1 * (node->value) + dist2 * (nodeNb->value) + nodeEdge->cost; 
-                    double tot_dist = dist1 + dist2 + nodeEdge->dist;
-                    possibleEdges.insert(std::make_tuple(nodeEdge->id, nodeEdgeNb->id, tot_cost, tot_dist));
                 }
             }
         }
@@ -340,7 +395,6 @@ int LcpFinder::doNextIteration(){
     }
 }
 
-
 // ------- findLcp -------
 // after the network as been fully or partially constructed using 'getLcp()' or  
 // 'makeNetwork*()', finds the path from start node to the end node
@@ -348,9 +402,9 @@ int LcpFinder::doNextIteration(){
 //   endNodeID: the ID of the node we want to find a path to
 // RETURNS:  a vector of NodeEdges that represent the path to the end node
 std::vector<std::shared_ptr<LcpFinder::NodeEdge>> LcpFinder::findLcp(int endNodeID){
-    std::map<int,int>::iterator itr = dict.find(endNodeID); //see if this node is included in our dictionary - if not, then it must fall outside our search extent
-    if(itr != dict.end()){
-        std::shared_ptr<NodeEdge> currentNodeEdge = nodeEdges.at(itr->second); //get the pointer to the nodeEdge that corresponds with the ID provided by the user
+    int i = dict.get(endNodeID); //see if this node is included in our dictionary - if not, then it must fall outside our search extent (or the algorithm hasn't reached it yet)
+    if(i != -1){
+        std::shared_ptr<NodeEdge> currentNodeEdge = nodeEdges.at(i); //get the pointer to the nodeEdge that corresponds with the ID provided by the user
         
         if(currentNodeEdge->parent.lock()){ //if this NodeEdge doesn't have a parent then that means it's unreachable
             std::vector<std::shared_ptr<NodeEdge>> nodePath(currentNodeEdge->nNodesFromOrigin); //initialize the vector that will store the nodes in the path. Use the 'nNodesFromOrigin' property of the destination NodeEdge to determine the size of the vector
@@ -376,9 +430,10 @@ std::vector<std::shared_ptr<LcpFinder::NodeEdge>> LcpFinder::findLcp(int endNode
 // PARAMETERS: same as 'findLcp()'
 // RETURNS: same as 'findLcp()'
 std::vector<std::shared_ptr<LcpFinder::NodeEdge>> LcpFinder::getLcp(int endNodeID){
-    std::map<int,int>::iterator itr = dict.find(endNodeID); // see if this node is included in our dictionary - if not, then it must fall outside our search extent
-    if(itr != dict.end()){
-        if(!nodeEdges.at(itr->second)->parent.lock()){ // check if we've already found the path to this node
+    std::shared_ptr<Node> endNode = quadtree->getNode(endNodeID);
+    if(endNode && !endNode->hasChildren && !std::isnan(endNode->value) && isInSearchArea(*endNode)){ // if the node is NA or falls outside the search area there's no point in running the algorithm
+        int i = dict.get(endNodeID); // the NodeEdge won't exist yet if the algorithm hasn't reached this node
+        if(i == -1 || !nodeEdges.at(i)->parent.lock()){ // check if we've already found the path to this node
             while(possibleEdges.size() != 0){ // if possibleEdges is 0 then we've added all the edges possible and we're done
                 int currentID = doNextIteration();
                 if(currentID == endNodeID){
@@ -402,6 +457,76 @@ std::vector<std::shared_ptr<LcpFinder::NodeEdge>> LcpFinder::getLcp(Point endPoi
     }
 }
 
+// ------- getLcps -------
+// finds the shortest paths to multiple points at once. Rather than running
+// 'getLcp()' for each point, this runs the algorithm until all of the end
+// nodes have been added to the network (or until there's nothing left to add)
+// and then traces each path back to the start node.
+// PARAMETERS:
+//   endPoints: the points we want to find paths to
+// RETURNS: a vector with one element per point in 'endPoints' - each element
+//   is the path to that point (see 'findLcp()'). If a point can't be reached,
+//   the corresponding path will be empty.
+std::vector<std::vector<std::shared_ptr<LcpFinder::NodeEdge>>> LcpFinder::getLcps(const std::vector<Point> &endPoints){
+    std::vector<int> endNodeIDs(endPoints.size(), -1);
+    NodeIndexMap isRemaining; // Key: node ID. Value: 1 if we still need to reach this node, 0 if we've reached it
+    int nRemaining{0};
+    for(size_t i = 0; i < endPoints.size(); ++i){
+        std::shared_ptr<Node> node = quadtree->getNode(endPoints[i]);
+        if(node && !std::isnan(node->value) && isInSearchArea(*node)){ // skip nodes that can't be reached
+            endNodeIDs[i] = node->id;
+            if(isRemaining.get(node->id) == -1){ // multiple points may fall in the same node
+                int iNodeEdge = dict.get(node->id);
+                if(iNodeEdge != -1 && nodeEdges[iNodeEdge]->parent.lock()){ // we may have already found the path to this node
+                    isRemaining.set(node->id, 0);
+                } else {
+                    isRemaining.set(node->id, 1);
+                    nRemaining++;
+                }
+            }
+        }
+    }
+    while(nRemaining > 0 && possibleEdges.size() != 0){
+        int currentID = doNextIteration();
+        if(currentID != -1 && isRemaining.get(currentID) == 1){
+            isRemaining.set(currentID, 0);
+            nRemaining--;
+        }
+    }
+    std::vector<std::vector<std::shared_ptr<NodeEdge>>> paths(endPoints.size());
+    for(size_t i = 0; i < endPoints.size(); ++i){
+        if(endNodeIDs[i] != -1){
+            paths[i] = findLcp(endNodeIDs[i]);
+        }
+    }
+    return paths;
+}
+
+// ------- getIsochrones -------
+// groups the cells that have been added to the LCP tree into bands based on
+// their cost-distance, and then gets the polygons outlining each band
+// PARAMETERS:
+//   breaks -> the break points of the bands, in increasing order. Band 'i'
+//      contains the cells where breaks[i] <= cost < breaks[i+1]
+// RETURNS: a vector with one element per band (i.e. 'breaks.size() - 1'
+//   elements) - see 'BoundaryTracer::trace()'
+std::vector<BoundaryTracer::MultiPolygon> LcpFinder::getIsochrones(const std::vector<double> &breaks){
+    int nBands = std::max(static_cast<int>(breaks.size()) - 1, 0);
+    std::vector<std::shared_ptr<Node>> nodes;
+    NodeIndexMap bands; // Key: node ID. Value: the band the node falls in
+    for(size_t i = 0; i < nodeEdges.size(); ++i){
+        if(!nodeEdges[i]->parent.expired()){
+            int band = std::upper_bound(breaks.begin(), breaks.end(), nodeEdges[i]->cost) - breaks.begin() - 1;
+            if(band >= 0 && band < nBands){
+                auto node = nodeEdges[i]->node.lock();
+                nodes.push_back(node);
+                bands.set(node->id, band);
+            }
+        }
+    }
+    return BoundaryTracer::trace(nodes, bands, nBands, *(quadtree->root));
+}
+
 // ------- makeNetworkAll -------
 // This function runs the shortest path algorithm exhaustively, meaning it finds all shortest paths
 // to all nodes. This creates a 'network' of NodeEdges, which we can query with 'getLcp()' to get
@@ -426,11 +551,14 @@ void LcpFinder::makeNetworkAll(){
 void LcpFinder::makeNetworkCostDist(double constraint){
     while(possibleEdges.size() != 0){ // if possibleEdges is 0 then we've added all the edges possible and we're done
         int currentID = doNextIteration();
-        int dictID = dict[currentID];
+        if(currentID == -1){ // no node was added
+            continue;
+        }
+        int dictID = dict.get(currentID);
         if(nodeEdges[dictID]->cost > constraint){ // check if we've exceed the max resistance value - if so, remove the most recently added edge (since it exceeds the limit) and then break out of the loop
             
             // reinsert the most recent edge that was just removed from 'possibleEdges' back into 'possibleEdges'
-            possibleEdges.insert(std::make_tuple(nodeEdges[dictID]->parent.lock()->id, nodeEdges[dictID]->id,nodeEdges[dictID]->cost,nodeEdges[dictID]->dist));
+            possibleEdges.insert(std::make_tuple(nodeEdges[dictID]->parent.lock()->node.lock()->id, currentID, nodeEdges[dictID]->cost, nodeEdges[dictID]->dist));
             
             // remove the most recently added edge from 'nodeEdges'
             nodeEdges[dictID]->parent = std::weak_ptr<NodeEdge>();
@@ -441,3 +569,285 @@ void LcpFinder::makeNetworkCostDist(double constraint){
         }
     }
 }
+
+// ------- makeNetworkParallel -------
+// multi-threaded version of 'makeNetworkAll()' and 'makeNetworkCostDist()'.
+// Rather than settling nodes one at a time like 'doNextIteration()' does, this
+// uses the "delta-stepping" algorithm (Meyer and Sanders, 2003). Nodes are
+// grouped into "buckets" of width 'delta' based on their tentative cost, and
+// all the nodes in the lowest bucket are processed at once - the edges coming
+// out of those nodes are relaxed in parallel. Within a bucket, "light" edges
+// (cost <= delta) may lead back into the same bucket, so those are relaxed
+// repeatedly until the bucket stops changing. "Heavy" edges can only lead to
+// later buckets, so they're relaxed once the bucket is finished.
+//
+// When a node can be reached by multiple edges, the edge with the lowest cost
+// is used, then the lowest distance, then the lowest ID of the source node.
+// This is the same ordering used by 'cmp' for 'possibleEdges', so the result
+// (costs, distances, and parents) is identical to the serial version.
+//
+// The state of the algorithm is saved in the same way as it is in the serial
+// version, so this can pick up where 'getLcp()' left off, and 'getLcp()' and
+// the other 'makeNetwork*()' functions can keep going after this is called.
+// PARAMETERS:
+//   constraint -> the maximum cost value allowed - use infinity to find all
+//      LCPs (i.e. to do the same thing as 'makeNetworkAll()')
+//   nThreads -> the number of threads to use
+void LcpFinder::makeNetworkParallel(double constraint, int nThreads){
+    if(possibleEdges.size() == 0){
+        return;
+    }
+    makeAllNodeEdges(); // NodeEdges can't be created on the fly when we're using multiple threads, so make them all now
+    int n = nodeEdges.size();
+    nThreads = std::max(1, nThreads);
+
+    // make a compact version of the network - for each NodeEdge, store the
+    // indices of its neighbors along with the cost and length of the edge that
+    // connects them. Neighbors outside the search area or that are NA are left
+    // out. This is done in two passes - the first counts the edges of each node
+    // so that we can allocate the arrays, the second fills them in.
+    std::vector<int> offsets(n + 1, 0);
+    parallel::forRange(n, nThreads, [&](int begin, int end, int){
+        for(int i = begin; i < end; ++i){
+            auto node = nodeEdges[i]->node.lock();
+            if(std::isnan(node->value)) continue; // NA nodes are never added to the network
+            int count{0};
+            for(size_t j = 0; j < node->neighbors.size(); ++j){
+                int iNb = dict.get(node->neighbors[j].lock()->id);
+                if(iNb != -1 && !std::isnan(nodeEdges[iNb]->node.lock()->value)){
+                    count++;
+                }
+            }
+            offsets[i + 1] = count;
+        }
+    });
+    for(int i = 0; i < n; ++i){
+        offsets[i + 1] += offsets[i];
+    }
+    std::vector<int> edgeTargets(offsets[n]);
+    std::vector<double> edgeCosts(offsets[n]);
+    std::vector<double> edgeDists(offsets[n]);
+    std::vector<double> costSums(nThreads, 0); // used to get the mean edge cost, which we'll use for 'delta'
+    parallel::forRange(n, nThreads, [&](int begin, int end, int thread){
+        for(int i = begin; i < end; ++i){
+            auto node = nodeEdges[i]->node.lock();
+            if(std::isnan(node->value)) continue;
+            int k = offsets[i];
+            for(size_t j = 0; j < node->neighbors.size(); ++j){
+                int iNb = dict.get(node->neighbors[j].lock()->id);
+                if(iNb != -1){
+                    auto nodeNb = nodeEdges[iNb]->node.lock();
+                    if(!std::isnan(nodeNb->value)){
+                        std::pair<double, double> edgeCost = getEdgeCost(*node, nodeEdges[i]->pt, *nodeNb, nodeEdges[iNb]->pt);
+                        edgeTargets[k] = iNb;
+                        edgeCosts[k] = edgeCost.first;
+                        edgeDists[k] = edgeCost.second;
+                        costSums[thread] += edgeCost.first;
+                        k++;
+                    }
+                }
+            }
+        }
+    });
+
+    double delta{0};
+    for(double sum : costSums){
+        delta += sum;
+    }
+    delta = (offsets[n] > 0) ? delta / offsets[n] : 0;
+    if(!(delta > 0) || !std::isfinite(delta)){
+        delta = 1; // all the edges have a cost of 0 - any positive value will work
+    }
+
+    // set up the state of the algorithm. Nodes that already have a parent have
+    // already been included in the network ('settled'), and the edges in
+    // 'possibleEdges' give us the starting (tentative) costs of the others
+    double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> cost(n, inf);
+    std::vector<double> dist(n, inf);
+    std::vector<int> parent(n, -1);
+    std::vector<char> settled(n, 0);
+    std::vector<int> steps(n, -1); // 'nNodesFromOrigin' - filled in at the end
+    std::vector<int> ids(n); // node IDs - used for breaking ties
+    for(int i = 0; i < n; ++i){
+        ids[i] = nodeEdges[i]->node.lock()->id;
+        if(nodeEdges[i]->parent.lock()){
+            settled[i] = 1;
+            cost[i] = nodeEdges[i]->cost;
+            dist[i] = nodeEdges[i]->dist;
+            steps[i] = nodeEdges[i]->nNodesFromOrigin;
+        }
+    }
+
+    // returns true if the edge is "better" than the edge currently used to
+    // reach 'req.target' - uses the same ordering as 'cmp'
+    auto isBetter = [&cost, &dist, &parent, &ids](const EdgeRequest &req) -> bool {
+        if(req.cost != cost[req.target]) return req.cost < cost[req.target];
+        if(req.dist != dist[req.target]) return req.dist < dist[req.target];
+        return parent[req.target] == -1 || ids[req.source] < ids[parent[req.target]];
+    };
+    auto getBucket = [delta](double val) -> long long {
+        return static_cast<long long>(std::floor(val / delta));
+    };
+
+    std::map<long long, std::vector<int>> buckets; // Key: bucket index. Value: indices of the nodes in the bucket. Nodes aren't removed when they move to a different bucket - instead, stale entries are skipped
+    for(auto const &edge : possibleEdges){
+        EdgeRequest req{dict.get(std::get<0>(edge)), dict.get(std::get<1>(edge)), std::get<2>(edge), std::get<3>(edge)};
+        if(!settled[req.target] && isBetter(req)){
+            cost[req.target] = req.cost;
+            dist[req.target] = req.dist;
+            parent[req.target] = req.source;
+        }
+    }
+    for(int i = 0; i < n; ++i){
+        if(!settled[i] && parent[i] != -1){
+            buckets[getBucket(cost[i])].push_back(i);
+        }
+    }
+
+    // relaxes the edges of the nodes in 'sources' and updates the tentative
+    // costs of their neighbors. Generating the edges and applying them are both
+    // done in parallel. When generating, each thread sorts its edges by the
+    // target node so that when applying, each thread is only ever responsible
+    // for updating a fixed subset of the nodes. Returns the nodes whose costs
+    // were lowered.
+    std::vector<char> isUpdated(n, 0);
+    auto relax = [&](const std::vector<int> &sources, bool light) -> std::vector<int> {
+        int nThreadsUsed = parallel::getNThreads(nThreads, sources.size(), 256);
+        std::vector<std::vector<std::vector<EdgeRequest>>> requests(nThreadsUsed, std::vector<std::vector<EdgeRequest>>(nThreadsUsed));
+        parallel::forRange(sources.size(), nThreadsUsed, [&](int begin, int end, int thread){
+            for(int i = begin; i < end; ++i){
+                int source = sources[i];
+                if(cost[source] > constraint) continue; // this node won't be settled, so we don't want any paths going through it
+                for(int k = offsets[source]; k < offsets[source + 1]; ++k){
+                    if((edgeCosts[k] <= delta) != light) continue;
+                    int target = edgeTargets[k];
+                    if(settled[target]) continue;
+                    EdgeRequest req{source, target, edgeCosts[k] + cost[source], edgeDists[k] + dist[source]};
+                    if(isBetter(req)){ // this check is just to avoid storing edges we'll definitely throw away - it's done again when applying the edges
+                        requests[thread][target % nThreadsUsed].push_back(req);
+                    }
+                }
+            }
+        });
+        std::vector<std::vector<int>> updated(nThreadsUsed);
+        parallel::forRange(nThreadsUsed, nThreadsUsed, [&](int begin, int end, int){
+            for(int owner = begin; owner < end; ++owner){
+                for(int thread = 0; thread < nThreadsUsed; ++thread){
+                    for(auto const &req : requests[thread][owner]){
+                        if(isBetter(req)){
+                            cost[req.target] = req.cost;
+                            dist[req.target] = req.dist;
+                            parent[req.target] = req.source;
+                            if(!isUpdated[req.target]){
+                                isUpdated[req.target] = 1;
+                                updated[owner].push_back(req.target);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+        std::vector<int> updatedAll;
+        for(auto const &vec : updated){
+            for(int i : vec){
+                isUpdated[i] = 0;
+                updatedAll.push_back(i);
+            }
+        }
+        return updatedAll;
+    };
+
+    std::vector<int> newlySettled;
+    std::vector<char> inBucket(n, 0);
+    while(!buckets.empty()){
+        long long bucket = buckets.begin()->first;
+        if(bucket * delta > constraint){ // every node left has a cost greater than the constraint
+            break;
+        }
+        std::vector<int> current;
+        for(int i : buckets.begin()->second){
+            if(!settled[i] && !inBucket[i] && getBucket(cost[i]) == bucket){
+                inBucket[i] = 1;
+                current.push_back(i);
+            }
+        }
+        buckets.erase(buckets.begin());
+
+        // keep relaxing light edges until no more nodes are added to this bucket
+        std::vector<int> bucketNodes;
+        while(!current.empty()){
+            bucketNodes.insert(bucketNodes.end(), current.begin(), current.end());
+            std::vector<int> updated = relax(current, true);
+            current.clear();
+            for(int i : updated){
+                long long iBucket = getBucket(cost[i]);
+                if(iBucket == bucket){
+                    if(!inBucket[i]){
+                        inBucket[i] = 1;
+                        current.push_back(i);
+                    } else {
+                        current.push_back(i); // it's already been processed once, but its cost has gone down so we need to relax its edges again
+                    }
+                } else {
+                    buckets[iBucket].push_back(i);
+                }
+            }
+            std::sort(current.begin(), current.end());
+            current.erase(std::unique(current.begin(), current.end()), current.end());
+        }
+
+        // the costs of the nodes in this bucket are now final
+        std::vector<int> settledNow;
+        for(int i : bucketNodes){
+            if(inBucket[i]){
+                inBucket[i] = 0;
+                if(cost[i] <= constraint){
+                    settled[i] = 1;
+                    settledNow.push_back(i);
+                }
+            }
+        }
+        std::vector<int> updated = relax(settledNow, false);
+        for(int i : updated){
+            buckets[getBucket(cost[i])].push_back(i);
+        }
+        newlySettled.insert(newlySettled.end(), settledNow.begin(), settledNow.end());
+    }
+
+    // now save the results to 'nodeEdges'. First we need to get the number of
+    // steps from the origin - nodes in the same bucket may be parents of each
+    // other, so we can't assume the parent has been done before the child
+    for(int i : newlySettled){
+        std::vector<int> stack;
+        int current = i;
+        while(steps[current] == -1){
+            stack.push_back(current);
+            if(parent[current] == current){ // the start node is its own parent
+                steps[current] = nodeEdges[current]->nNodesFromOrigin + 1;
+                stack.pop_back();
+                break;
+            }
+            current = parent[current];
+        }
+        while(!stack.empty()){
+            steps[stack.back()] = steps[parent[stack.back()]] + 1;
+            stack.pop_back();
+        }
+    }
+    for(int i : newlySettled){
+        nodeEdges[i]->parent = std::weak_ptr<NodeEdge>(nodeEdges[parent[i]]);
+        nodeEdges[i]->cost = cost[i];
+        nodeEdges[i]->dist = dist[i];
+        nodeEdges[i]->nNodesFromOrigin = steps[i];
+    }
+
+    // replace 'possibleEdges' with the best edge to each of the nodes that
+    // haven't been settled, so that the serial version can keep going from here
+    possibleEdges.clear();
+    for(int i = 0; i < n; ++i){
+        if(!settled[i] && parent[i] != -1){
+            possibleEdges.insert(std::make_tuple(ids[parent[i]], ids[i], cost[i], dist[i]));
+        }
+    }
+}
@@ -1,7 +1,9 @@
 #ifndef LCPFINDER_H
 #define LCPFINDER_H
 
+#include "BoundaryTracer.h"
 #include "Node.h"
+#include "NodeIndexMap.h"
 #include "Point.h"
 #include "Quadtree.h"
 
@@ -9,6 +11,7 @@
 #include <memory>
 #include <set>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 class LcpFinder{
@@ -39,8 +42,19 @@ private:
         }
     };
 
+    // a possible edge in the parallel version of the algorithm - see 'makeNetworkParallel()'
+    struct EdgeRequest{
+        int source;     // index of the NodeEdge the edge starts from
+        int target;     // index of the NodeEdge the edge goes to
+        double cost;    // TOTAL cost from the origin to 'target' if this edge is used
+        double dist;    // TOTAL distance from the origin to 'target' if this edge is used
+    };
+
     void init(int startNodeID);
     void makeNodePointMap(std::vector<Point> newPoints);
+    bool isInSearchArea(const Node &node) const;
+    int getNodeEdgeIndex(const std::shared_ptr<Node> &node);
+    void makeAllNodeEdges();
 public:
     // represents a single node. But because the result of the LCP algorithm is a tree, it also
     // contains a field for the 'parent' of the node. This 'parent' field is essential to storing
@@ -64,9 +78,9 @@ public:
     double yMax{0};
 
     std::shared_ptr<Node> startNode; // the start node - the node from which all LCPs will be found
-    std::vector<std::shared_ptr<NodeEdge>> nodeEdges; // this contains the nodes of the LCP tree. there is one NodeEdge per node. When initialized, the 'parent', 'dist', 'cost', and 'nNodesFromOrigin' properties are empty - these get filled in once the node gets added to the LCP tree
-    std::map<int, int> dict; // dictionary. Key: Node ID's. Value: index of the corresponding 'NodeEdge' in 'nodeEdges'
-    std::multiset<std::tuple<int,int,double,double>, cmp> possibleEdges; // set that contains info on the possible edges - the items in the tuple represent (in this order): ID of the first node in the edge; ID of the second node in the edge; cost-distance of the edge; cost of the edge
+    std::vector<std::shared_ptr<NodeEdge>> nodeEdges; // this contains the nodes of the LCP tree. there is one NodeEdge per node, but NodeEdges are only created once the algorithm reaches the node, so nodes that haven't been reached yet may not have one. When created, the 'parent', 'dist', 'cost', and 'nNodesFromOrigin' properties are empty - these get filled in once the node gets added to the LCP tree
+    NodeIndexMap dict; // dictionary. Key: Node ID's. Value: index of the corresponding 'NodeEdge' in 'nodeEdges'. Only contains the nodes the algorithm has reached, so it stays small when the search is limited (e.g. by 'makeNetworkCostDist()')
+    std::multiset<std::tuple<int,int,double,double>, cmp> possibleEdges; // set that contains info on the possible edges - the items in the tuple represent (in this order): ID of the first node in the edge; ID of the second node in the edge; cost-distance of the edge; cost of the edge. Note that these are the IDs of the Nodes, not the NodeEdges
     std::map<int, Point> nodePointMap; // maps nodes to points - used to customize the point used to represent the node. Key: node ID. Value: the point to use for that node
 
     bool includeNodesByCentroid{false}; // should nodes be included if any part of the node overlaps with the search area (false), or only if the *centroid* falls in the search area (true)?
@@ -80,15 +94,19 @@ public:
     LcpFinder(std::shared_ptr<Quadtree> _quadtree, Point startPoint, double _xMin, double _xMax, double _yMin, double _yMax, std::map<int, Point> _nodePointMap, bool _includeNodesByCentroid);
     LcpFinder(std::shared_ptr<Quadtree> _quadtree, int startNodeID, double _xMin, double _xMax, double _yMin, double _yMax, std::vector<Point> newPoints, bool _includeNodesByCentroid);
     LcpFinder(std::shared_ptr<Quadtree> _quadtree, Point startPoint, double _xMin, double _xMax, double _yMin, double _yMax, std::vector<Point> newPoints, bool _includeNodesByCentroid);
+    static std::pair<double, double> getEdgeCost(const Node &node, const Point &pt, const Node &nodeNb, const Point &ptNb);
     int doNextIteration();
 
     std::vector<std::shared_ptr<NodeEdge>> findLcp(int endNodeID);
     
     std::vector<std::shared_ptr<NodeEdge>> getLcp(int endNodeID);
     std::vector<std::shared_ptr<NodeEdge>> getLcp(Point endPoint);
+    std::vector<std::vector<std::shared_ptr<NodeEdge>>> getLcps(const std::vector<Point> &endPoints);
+    std::vector<BoundaryTracer::MultiPolygon> getIsochrones(const std::vector<double> &breaks);
 
     void makeNetworkAll();
     void makeNetworkCostDist(double constraint);
+    void makeNetworkParallel(double constraint, int nThreads);
 };
 
 #endif
\ No newline at end of file
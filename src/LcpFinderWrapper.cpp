@@ -2,7 +2,11 @@
 
 #include "Point.h"
 
+#include <algorithm>
+#include <iomanip>
+#include <limits>
 #include <map>
+#include <sstream>
 
 LcpFinderWrapper::LcpFinderWrapper(std::shared_ptr<Quadtree> quadtree, Rcpp::NumericVector _startPoint)
     : startPoint{_startPoint}{
@@ -26,12 +30,20 @@ LcpFinderWrapper::LcpFinderWrapper(std::shared_ptr<Quadtree> quadtree, Rcpp::Num
   lcpFinder = LcpFinder(quadtree, Point(startPoint[0], startPoint[1]), xlim[0], xlim[1], ylim[0], ylim[1], points, searchByCentroid);
 }
 
-void LcpFinderWrapper::makeNetworkAll(){
-  lcpFinder.makeNetworkAll();
+void LcpFinderWrapper::makeNetworkAll(int nThreads){
+  if(nThreads > 1){
+    lcpFinder.makeNetworkParallel(std::numeric_limits<double>::infinity(), nThreads);
+  } else {
+    lcpFinder.makeNetworkAll();
+  }
 }
 
-void LcpFinderWrapper::makeNetworkCostDist(double constraint){
-  lcpFinder.makeNetworkCostDist(constraint);
+void LcpFinderWrapper::makeNetworkCostDist(double constraint, int nThreads){
+  if(nThreads > 1){
+    lcpFinder.makeNetworkParallel(constraint, nThreads);
+  } else {
+    lcpFinder.makeNetworkCostDist(constraint);
+  }
 }
 
 Rcpp::NumericMatrix LcpFinderWrapper::getLcp(Rcpp::NumericVector endPoint, bool allowSameCellPath){
@@ -69,37 +81,187 @@ Rcpp::NumericMatrix LcpFinderWrapper::getLcp(Rcpp::NumericVector endPoint, bool
   return mat;
 }
 
-Rcpp::NumericMatrix LcpFinderWrapper::getAllPathsSummary(){
-  //first we need to know how many "found" paths are currently in the network
-  int nPaths{0};
+// finds the LCPs to multiple points and returns them all in a single matrix,
+// where each row is one point on one of the paths. 'path_id' is the (1-based)
+// row of 'endPoints' the path goes to and 'step' is the (1-based) position of
+// the point in the path. Unreachable points have no rows.
+Rcpp::NumericMatrix LcpFinderWrapper::getLcps(Rcpp::NumericMatrix endPoints, bool allowSameCellPath){
+  std::vector<Point> points(endPoints.nrow());
+  for(int i = 0; i < endPoints.nrow(); ++i){
+    points[i] = Point(endPoints(i,0), endPoints(i,1));
+  }
+  std::vector<std::vector<std::shared_ptr<LcpFinder::NodeEdge>>> paths = lcpFinder.getLcps(points);
+
+  // figure out how many rows we need
+  int nRow{0};
+  for(size_t i = 0; i < paths.size(); ++i){
+    nRow += paths[i].size();
+    if(allowSameCellPath && paths[i].size() == 1){
+      nRow++;
+    }
+  }
+
+  Rcpp::NumericMatrix mat(nRow,8);
+  colnames(mat) = Rcpp::CharacterVector({"path_id", "step", "x", "y", "cost_tot", "dist_tot", "cost_cell", "cell_id"}); //name the columns
+  int row{0};
+  for(size_t i = 0; i < paths.size(); ++i){
+    std::vector<std::shared_ptr<LcpFinder::NodeEdge>> &path = paths[i];
+    for(size_t j = 0; j < path.size(); ++j){
+      auto node = path[j]->node.lock();
+      mat(row,0) = i + 1;
+      mat(row,1) = j + 1;
+      mat(row,2) = path[j]->pt.x;
+      mat(row,3) = path[j]->pt.y;
+      mat(row,4) = path[j]->cost;
+      mat(row,5) = path[j]->dist;
+      mat(row,6) = node->value;
+      mat(row,7) = node->id;
+      row++;
+    }
+    if(allowSameCellPath && path.size() == 1){ // same as in 'getLcp()' - add the end point itself
+      double dist = std::sqrt(std::pow(points[i].x - path[0]->pt.x, 2) + std::pow(points[i].y - path[0]->pt.y, 2));
+      auto node = path[0]->node.lock();
+      mat(row,0) = i + 1;
+      mat(row,1) = 2;
+      mat(row,2) = points[i].x;
+      mat(row,3) = points[i].y;
+      mat(row,4) = node->value * dist;
+      mat(row,5) = dist;
+      mat(row,6) = node->value;
+      mat(row,7) = node->id;
+      row++;
+    }
+  }
+  return mat;
+}
+
+// returns the NodeEdges that have been added to the LCP tree (i.e. the ones we
+// have a path to). NodeEdges are created in the order the algorithm reaches
+// them, so they're sorted by node ID to keep the output in a consistent order
+std::vector<std::shared_ptr<LcpFinder::NodeEdge>> LcpFinderWrapper::getFoundNodeEdges(){
+  std::vector<std::shared_ptr<LcpFinder::NodeEdge>> found;
   for(size_t i = 0; i < lcpFinder.nodeEdges.size(); ++i){
-    if(lcpFinder.nodeEdges.at(i)->parent.lock()){
-      nPaths++;
+    if(!lcpFinder.nodeEdges[i]->parent.expired()){
+      found.push_back(lcpFinder.nodeEdges[i]);
     }
   }
-  
-  //now we can construct a matrix to store info on each path
-  Rcpp::NumericMatrix mat(nPaths,9);
+  std::sort(found.begin(), found.end(), [](const std::shared_ptr<LcpFinder::NodeEdge> &a, const std::shared_ptr<LcpFinder::NodeEdge> &b){
+    return a->node.lock()->id < b->node.lock()->id;
+  });
+  return found;
+}
+
+Rcpp::NumericMatrix LcpFinderWrapper::getAllPathsSummary(){
+  std::vector<std::shared_ptr<LcpFinder::NodeEdge>> found = getFoundNodeEdges();
+  Rcpp::NumericMatrix mat(found.size(),9);
   colnames(mat) = Rcpp::CharacterVector({"id","xmin","xmax", "ymin", "ymax","value","area","lcp_cost","lcp_dist"}); //name the columns
-  int counter = 0; 
-  for(size_t i = 0; i < lcpFinder.nodeEdges.size(); ++i){
-    if(lcpFinder.nodeEdges[i]->parent.lock()){
-      std::shared_ptr<Node> node = lcpFinder.nodeEdges[i]->node.lock();
-      mat(counter,0) = node->id;
-      mat(counter,1) = node->xMin;
-      mat(counter,2) = node->xMax;
-      mat(counter,3) = node->yMin;
-      mat(counter,4) = node->yMax;
-      mat(counter,5) = node->value;
-      mat(counter,6) = (node->xMax - node->xMin) * (node->yMax - node->yMin);
-      mat(counter,7) = lcpFinder.nodeEdges[i]->cost;
-      mat(counter,8) = lcpFinder.nodeEdges[i]->dist;
-      counter++;
+  for(size_t i = 0; i < found.size(); ++i){
+    std::shared_ptr<Node> node = found[i]->node.lock();
+    mat(i,0) = node->id;
+    mat(i,1) = node->xMin;
+    mat(i,2) = node->xMax;
+    mat(i,3) = node->yMin;
+    mat(i,4) = node->yMax;
+    mat(i,5) = node->value;
+    mat(i,6) = (node->xMax - node->xMin) * (node->yMax - node->yMin);
+    mat(i,7) = found[i]->cost;
+    mat(i,8) = found[i]->dist;
+  }
+  return mat;
+}
+
+// returns the LCP tree - one row per cell in the tree, with the ID of its
+// parent, so the full tree can be reconstructed without having to retrieve
+// each LCP individually. If 'asSegments' is true, each row instead represents
+// the segment connecting a cell to its parent (the start cell, which is its
+// own parent, is left out) - this is the format 'segments()' uses.
+// Everything needed for a row is taken from the NodeEdge and its parent in a
+// single pass over 'nodeEdges' (locking each pointer once), and the rows are
+// then sorted by ID - unlike 'getFoundNodeEdges()', the sort doesn't have to
+// lock the node pointers again.
+Rcpp::NumericMatrix LcpFinderWrapper::getLcpTree(bool asSegments){
+  struct TreeRow{
+    int id;
+    int parentId;
+    const LcpFinder::NodeEdge *nodeEdge;
+    const LcpFinder::NodeEdge *parent;
+  };
+  std::vector<TreeRow> rows;
+  rows.reserve(lcpFinder.nodeEdges.size());
+  int nStart{0};
+  for(auto const &nodeEdge : lcpFinder.nodeEdges){
+    std::shared_ptr<LcpFinder::NodeEdge> parent = nodeEdge->parent.lock();
+    if(!parent) continue; // not in the tree yet
+    rows.push_back(TreeRow{nodeEdge->node.lock()->id, parent->node.lock()->id, nodeEdge.get(), parent.get()});
+    if(parent == nodeEdge) nStart++;
+  }
+  std::sort(rows.begin(), rows.end(), [](const TreeRow &a, const TreeRow &b){
+    return a.id < b.id;
+  });
+
+  if(asSegments){
+    Rcpp::NumericMatrix mat(rows.size() - nStart,6);
+    colnames(mat) = Rcpp::CharacterVector({"id","parent_id","x0","y0","x1","y1"});
+    int row{0};
+    for(auto const &treeRow : rows){
+      if(treeRow.parent == treeRow.nodeEdge) continue; // the start cell
+      mat(row,0) = treeRow.id;
+      mat(row,1) = treeRow.parentId;
+      mat(row,2) = treeRow.parent->pt.x;
+      mat(row,3) = treeRow.parent->pt.y;
+      mat(row,4) = treeRow.nodeEdge->pt.x;
+      mat(row,5) = treeRow.nodeEdge->pt.y;
+      row++;
     }
+    return mat;
+  }
+  Rcpp::NumericMatrix mat(rows.size(),7);
+  colnames(mat) = Rcpp::CharacterVector({"id","parent_id","lcp_cost","lcp_dist","n_steps","x","y"});
+  for(size_t i = 0; i < rows.size(); ++i){
+    mat(i,0) = rows[i].id;
+    mat(i,1) = rows[i].parentId;
+    mat(i,2) = rows[i].nodeEdge->cost;
+    mat(i,3) = rows[i].nodeEdge->dist;
+    mat(i,4) = rows[i].nodeEdge->nNodesFromOrigin;
+    mat(i,5) = rows[i].nodeEdge->pt.x;
+    mat(i,6) = rows[i].nodeEdge->pt.y;
   }
   return mat;
 }
 
+// gets the polygons for each cost-distance band (see 'LcpFinder::getIsochrones()')
+// and returns them as Well-Known Text (WKT) - one MULTIPOLYGON per band. Also
+// returns the projection of the quadtree so the R side can set the CRS.
+Rcpp::List LcpFinderWrapper::getIsochrones(Rcpp::NumericVector breaks){
+  std::vector<double> breaksVec(breaks.begin(), breaks.end());
+  std::vector<BoundaryTracer::MultiPolygon> bands = lcpFinder.getIsochrones(breaksVec);
+  Rcpp::CharacterVector wkt(bands.size());
+  for(size_t i = 0; i < bands.size(); ++i){
+    if(bands[i].size() == 0){
+      wkt[i] = "MULTIPOLYGON EMPTY";
+      continue;
+    }
+    std::ostringstream stream;
+    stream << std::setprecision(15) << "MULTIPOLYGON (";
+    for(size_t j = 0; j < bands[i].size(); ++j){
+      stream << (j == 0 ? "(" : ", (");
+      for(size_t k = 0; k < bands[i][j].size(); ++k){
+        const BoundaryTracer::Ring &ring = bands[i][j][k];
+        stream << (k == 0 ? "(" : ", (");
+        for(size_t m = 0; m <= ring.size(); ++m){ // WKT rings have to be closed, so repeat the first point at the end
+          const Point &pt = ring[m % ring.size()];
+          stream << (m == 0 ? "" : ", ") << pt.x << " " << pt.y;
+        }
+        stream << ")";
+      }
+      stream << ")";
+    }
+    stream << ")";
+    wkt[i] = stream.str();
+  }
+  return Rcpp::List::create(Rcpp::Named("wkt") = wkt, Rcpp::Named("crs") = lcpFinder.quadtree->projection);
+}
+
 Rcpp::NumericVector LcpFinderWrapper::getStartPoint(){
   Rcpp::NumericVector vec(2);
   vec[0] = startPoint[0];
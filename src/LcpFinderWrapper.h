@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 class LcpFinderWrapper{
 public:
@@ -18,11 +19,15 @@ public:
   LcpFinderWrapper(std::shared_ptr<Quadtree> quadtree, Rcpp::NumericVector _startPoint, Rcpp::NumericVector xlim, Rcpp::NumericVector ylim, bool searchByCentroid);
   LcpFinderWrapper(std::shared_ptr<Quadtree> quadtree, Rcpp::NumericVector _startPoint, Rcpp::NumericVector xlim, Rcpp::NumericVector ylim, Rcpp::NumericMatrix newPoints, bool searchByCentroid);
   
-  void makeNetworkAll();
-  void makeNetworkCostDist(double constraint);
+  void makeNetworkAll(int nThreads);
+  void makeNetworkCostDist(double constraint, int nThreads);
   Rcpp::NumericMatrix getLcp(Rcpp::NumericVector endPoint, bool sameCellPath);
+  Rcpp::NumericMatrix getLcps(Rcpp::NumericMatrix endPoints, bool sameCellPath);
 
+  std::vector<std::shared_ptr<LcpFinder::NodeEdge>> getFoundNodeEdges();
   Rcpp::NumericMatrix getAllPathsSummary();
+  Rcpp::NumericMatrix getLcpTree(bool asSegments);
+  Rcpp::List getIsochrones(Rcpp::NumericVector breaks);
   Rcpp::NumericVector getStartPoint();
   Rcpp::NumericVector getSearchLimits();
 };
@@ -0,0 +1,246 @@
+#include "LeafGraph.h"
+#include "LcpFinder.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <tuple>
+
+LeafGraph::LeafGraph(){}
+
+// ------- LeafGraph -------
+// collects the leaves of the quadtree and builds the CSR adjacency structure
+LeafGraph::LeafGraph(const Quadtree &quadtree){
+    // get all of the leaves
+    std::vector<std::shared_ptr<Node>> stack{quadtree.root};
+    while(!stack.empty()){
+        std::shared_ptr<Node> node = stack.back();
+        stack.pop_back();
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                stack.push_back(child);
+            }
+        } else {
+            leaves.push_back(node);
+        }
+    }
+    std::sort(leaves.begin(), leaves.end(), [](const std::shared_ptr<Node> &a, const std::shared_ptr<Node> &b){
+        return a->id < b->id;
+    });
+    for(size_t i = 0; i < leaves.size(); ++i){
+        indices.set(leaves[i]->id, i);
+    }
+
+    // add each edge in both directions - the 'neighbors' vectors aren't
+    // guaranteed to be symmetric when the cells aren't square
+    std::vector<std::vector<int>> rows(leaves.size());
+    for(size_t i = 0; i < leaves.size(); ++i){
+        if(std::isnan(leaves[i]->value)) continue;
+        for(auto const &nbWeak : leaves[i]->neighbors){
+            auto nb = nbWeak.lock();
+            int j = indices.get(nb->id);
+            if(j == -1 || j == static_cast<int>(i) || std::isnan(nb->value)) continue;
+            rows[i].push_back(j);
+            rows[j].push_back(i);
+        }
+    }
+    offsets.resize(leaves.size() + 1, 0);
+    for(size_t i = 0; i < rows.size(); ++i){
+        std::sort(rows[i].begin(), rows[i].end());
+        rows[i].erase(std::unique(rows[i].begin(), rows[i].end()), rows[i].end());
+        offsets[i + 1] = offsets[i] + rows[i].size();
+    }
+    adjacency.reserve(offsets.back());
+    for(auto const &row : rows){
+        adjacency.insert(adjacency.end(), row.begin(), row.end());
+    }
+}
+
+int LeafGraph::size() const{
+    return leaves.size();
+}
+
+// ------- getComponents -------
+// labels the connected components of the non-NA leaves using union-find.
+// When more than one thread is used, the leaves are split into contiguous
+// blocks of indices (since IDs are assigned depth-first, each block is a
+// spatially compact group of cells), each thread joins the edges that fall
+// entirely inside its block, and then the edges between blocks are joined on
+// the main thread.
+// PARAMETERS:
+//   nThreads -> the number of threads to use
+// RETURNS: a vector with one element per leaf - the component of the leaf, or
+//   -1 if the leaf is NA. Components are numbered from 0, in order of the
+//   smallest ID in each component, so the result doesn't depend on the number
+//   of threads.
+std::vector<int> LeafGraph::getComponents(int nThreads) const{
+    int n = leaves.size();
+    std::vector<int> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+
+    // always keep the smaller index as the root - this keeps each root inside
+    // the block that's being processed, so threads never write to each other's
+    // blocks
+    auto find = [&parent](int i){
+        while(parent[i] != i){
+            parent[i] = parent[parent[i]]; // path halving
+            i = parent[i];
+        }
+        return i;
+    };
+    auto join = [&parent, &find](int i, int j){
+        int ri = find(i);
+        int rj = find(j);
+        if(ri < rj) parent[rj] = ri;
+        else if(rj < ri) parent[ri] = rj;
+    };
+
+    std::vector<int> block(n, 0);
+    parallel::forRange(n, parallel::getNThreads(nThreads, n, 1024), [&](int begin, int end, int thread){
+        for(int i = begin; i < end; ++i){
+            block[i] = thread;
+            for(int k = offsets[i]; k < offsets[i + 1]; ++k){
+                int j = adjacency[k];
+                if(j >= begin && j < end) join(i, j);
+            }
+        }
+    });
+    for(int i = 0; i < n; ++i){ // merge the blocks
+        for(int k = offsets[i]; k < offsets[i + 1]; ++k){
+            int j = adjacency[k];
+            if(block[j] != block[i]) join(i, j);
+        }
+    }
+
+    std::vector<int> components(n, -1);
+    int nComponents{0};
+    for(int i = 0; i < n; ++i){
+        if(std::isnan(leaves[i]->value)) continue;
+        int root = find(i);
+        if(root == i){ // the root is the smallest index in the component, so we'll always see it first
+            components[i] = nComponents++;
+        } else {
+            components[i] = components[root];
+        }
+    }
+    return components;
+}
+
+// ------- makeEdgeCosts -------
+// calculates the cost and length of each edge (see 'LcpFinder::getEdgeCost()')
+void LeafGraph::makeEdgeCosts(){
+    edgeCosts.resize(adjacency.size());
+    edgeDists.resize(adjacency.size());
+    for(int i = 0; i < size(); ++i){
+        const Node &node = *leaves[i];
+        Point pt((node.xMin + node.xMax) / 2, (node.yMin + node.yMax) / 2);
+        for(int k = offsets[i]; k < offsets[i + 1]; ++k){
+            const Node &nb = *leaves[adjacency[k]];
+            Point ptNb((nb.xMin + nb.xMax) / 2, (nb.yMin + nb.yMax) / 2);
+            std::pair<double, double> costDist = LcpFinder::getEdgeCost(node, pt, nb, ptNb);
+            edgeCosts[k] = costDist.first;
+            edgeDists[k] = costDist.second;
+        }
+    }
+}
+
+// ------- getCostDistances -------
+// finds the cost of the least-cost path from one leaf to every other leaf
+// using Dijkstra's algorithm. As in 'LcpFinder', ties in cost are broken by
+// distance. 'makeEdgeCosts()' must be called first.
+// PARAMETERS:
+//   source -> index (in 'leaves') of the leaf to start from
+//   costs -> filled with the total cost to each leaf (infinity for leaves
+//      that can't be reached)
+//   dists -> filled with the total distance to each leaf (infinity for leaves
+//      that can't be reached)
+//   parents -> optional; if not null, filled with the index of the previous
+//      leaf in the LCP to each leaf (-1 for the source and for leaves that
+//      can't be reached)
+//   order -> optional; if not null, filled with the indices of the leaves that
+//      were reached, in the order they were added to the LCP tree (so every
+//      leaf comes after its parent)
+void LeafGraph::getCostDistances(int source, std::vector<double> &costs, std::vector<double> &dists, std::vector<int> *parents, std::vector<int> *order) const{
+    costs.assign(size(), std::numeric_limits<double>::infinity());
+    dists.assign(size(), std::numeric_limits<double>::infinity());
+    if(parents) parents->assign(size(), -1);
+    if(order) order->clear();
+    if(source < 0 || source >= size() || std::isnan(leaves[source]->value)) return;
+
+    typedef std::tuple<double, double, int> Entry; // cost, distance, index
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    costs[source] = 0;
+    dists[source] = 0;
+    queue.push(Entry(0, 0, source));
+    while(!queue.empty()){
+        double cost = std::get<0>(queue.top());
+        double dist = std::get<1>(queue.top());
+        int i = std::get<2>(queue.top());
+        queue.pop();
+        if(cost > costs[i] || (cost == costs[i] && dist > dists[i])) continue; // we've already found a better path to this leaf
+        if(order) order->push_back(i);
+        for(int k = offsets[i]; k < offsets[i + 1]; ++k){
+            int j = adjacency[k];
+            double newCost = cost + edgeCosts[k];
+            double newDist = dist + edgeDists[k];
+            if(newCost < costs[j] || (newCost == costs[j] && newDist < dists[j])){
+                costs[j] = newCost;
+                dists[j] = newDist;
+                if(parents) (*parents)[j] = i;
+                queue.push(Entry(newCost, newDist, j));
+            }
+        }
+    }
+}
+
+// ------- getBetweenness -------
+// counts how many least-cost paths pass through each leaf. An LCP tree is
+// built from each source, and the number of targets "below" each leaf in the
+// tree is the number of paths from the source that pass through it. The
+// sources are split between the threads, and each thread keeps its own
+// counts, which are added together at the end. 'makeEdgeCosts()' must be
+// called first.
+// PARAMETERS:
+//   sources -> indices (in 'leaves') of the leaves to find LCPs from
+//   isTarget -> one element per leaf - non-zero for leaves that should be
+//      treated as the ends of paths
+//   nThreads -> the number of threads to use
+// RETURNS: a vector with one element per leaf - the number of (source,
+//   target) paths that pass through the leaf. The first and last cells of a
+//   path aren't counted.
+std::vector<double> LeafGraph::getBetweenness(const std::vector<int> &sources, const std::vector<char> &isTarget, int nThreads) const{
+    int n = size();
+    nThreads = parallel::getNThreads(nThreads, sources.size());
+    // the buffers are sized here rather than in the threads, since no threads
+    // are run if there aren't any sources
+    std::vector<std::vector<double>> scores(nThreads, std::vector<double>(n, 0));
+    parallel::forRange(sources.size(), nThreads, [&](int begin, int end, int thread){
+        std::vector<double> &threadScores = scores[thread];
+        std::vector<double> costs, dists;
+        std::vector<int> parents, order;
+        std::vector<double> below(n, 0); // number of targets in the subtree of each leaf
+        for(int s = begin; s < end; ++s){
+            getCostDistances(sources[s], costs, dists, &parents, &order);
+            for(int i : order){
+                below[i] = (isTarget[i] && i != sources[s]) ? 1 : 0;
+            }
+            for(auto itr = order.rbegin(); itr != order.rend(); ++itr){ // children always come after their parents
+                int i = *itr;
+                if(parents[i] == -1) continue; // the source
+                threadScores[i] += below[i] - (isTarget[i] ? 1 : 0);
+                below[parents[i]] += below[i];
+            }
+        }
+    });
+    std::vector<double> total(n, 0);
+    for(auto const &threadScores : scores){
+        for(int i = 0; i < n; ++i){
+            total[i] += threadScores[i];
+        }
+    }
+    return total;
+}
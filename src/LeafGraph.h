@@ -0,0 +1,45 @@
+#ifndef LEAFGRAPH_H
+#define LEAFGRAPH_H
+
+#include "Node.h"
+#include "NodeIndexMap.h"
+#include "Point.h"
+#include "Quadtree.h"
+
+#include <memory>
+#include <vector>
+
+// a compact, read-only view of the adjacency between the leaves of a quadtree.
+// The leaves are stored in order of their IDs and given a dense index (0 to
+// n - 1), and the neighbors of each leaf are stored in compressed sparse row
+// (CSR) format - the neighbors of leaf 'i' are
+// 'adjacency[offsets[i]]' to 'adjacency[offsets[i + 1] - 1]'.
+//
+// Only cells that aren't NA are connected - NA leaves are included in 'leaves'
+// (so that every leaf has an index) but never have any neighbors. The edges
+// are symmetric even if the 'neighbors' vectors of the nodes aren't.
+//
+// Edge costs aren't calculated until 'makeEdgeCosts()' is called, since not
+// everything that uses the graph needs them. They're calculated in the same
+// way as 'LcpFinder' calculates them, using the centroids of the cells.
+class LeafGraph{
+public:
+    std::vector<std::shared_ptr<Node>> leaves; // the leaves, in order of their IDs
+    NodeIndexMap indices; // Key: node ID. Value: index of the node in 'leaves'
+    std::vector<int> offsets; // CSR row offsets - has 'leaves.size() + 1' elements
+    std::vector<int> adjacency; // CSR column indices - indices (in 'leaves') of the neighbors
+    std::vector<double> edgeCosts; // cost of each edge - same order as 'adjacency'. Empty until 'makeEdgeCosts()' is called
+    std::vector<double> edgeDists; // length of each edge - same order as 'adjacency'. Empty until 'makeEdgeCosts()' is called
+
+    LeafGraph();
+    LeafGraph(const Quadtree &quadtree);
+
+    int size() const;
+    std::vector<int> getComponents(int nThreads) const;
+
+    void makeEdgeCosts();
+    void getCostDistances(int source, std::vector<double> &costs, std::vector<double> &dists, std::vector<int> *parents = nullptr, std::vector<int> *order = nullptr) const;
+    std::vector<double> getBetweenness(const std::vector<int> &sources, const std::vector<char> &isTarget, int nThreads) const;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "MappedQuadtreeWrapper.h"
+
+#include <limits>
+
+MappedQuadtreeWrapper::MappedQuadtreeWrapper(std::shared_ptr<FlatQuadtree> _flatQuadtree) : flatQuadtree{_flatQuadtree} {}
+
+int MappedQuadtreeWrapper::nNodes() const{
+  return flatQuadtree->header().nNodes;
+}
+
+int MappedQuadtreeWrapper::nCells() const{
+  return flatQuadtree->header().nLeaves;
+}
+
+double MappedQuadtreeWrapper::minCellSize() const{
+  return flatQuadtree->node(0).smallestChildSideLength;
+}
+
+Rcpp::NumericVector MappedQuadtreeWrapper::extent() const{
+  const FlatQuadtree::Header &head = flatQuadtree->header();
+  Rcpp::NumericVector v = Rcpp::NumericVector::create(Rcpp::Named("xmin",head.xMin), Rcpp::Named("xmax", head.xMax), Rcpp::Named("ymin",head.yMin), Rcpp::Named("ymax", head.yMax));
+  return v;
+}
+
+Rcpp::NumericVector MappedQuadtreeWrapper::originalExtent() const{
+  const FlatQuadtree::Header &head = flatQuadtree->header();
+  Rcpp::NumericVector v = Rcpp::NumericVector::create(Rcpp::Named("xmin",head.originalXMin), Rcpp::Named("xmax", head.originalXMax), Rcpp::Named("ymin",head.originalYMin), Rcpp::Named("ymax", head.originalYMax));
+  return v;
+}
+
+Rcpp::NumericVector MappedQuadtreeWrapper::originalDim() const{
+  const FlatQuadtree::Header &head = flatQuadtree->header();
+  Rcpp::NumericVector v = Rcpp::NumericVector::create(Rcpp::Named("nX",head.originalNX), Rcpp::Named("nY",head.originalNY));
+  return v;
+}
+
+std::string MappedQuadtreeWrapper::getProjection() const{
+  return flatQuadtree->getProjection();
+}
+
+std::vector<std::string> MappedQuadtreeWrapper::getLayerNames() const{
+  std::vector<std::string> names = flatQuadtree->getLayerNames();
+  if(names.empty()) names.push_back("layer1"); // same as 'QuadtreeWrapper::getLayerNames()'
+  return names;
+}
+
+int MappedQuadtreeWrapper::getActiveLayer() const{
+  return flatQuadtree->header().activeLayer;
+}
+
+std::string MappedQuadtreeWrapper::getValueType() const{
+  return ValueVector::typeToString(static_cast<ValueVector::Type>(flatQuadtree->header().valueType));
+}
+
+std::vector<double> MappedQuadtreeWrapper::getValues(const std::vector<double> &x, const std::vector<double> &y) const{
+  std::vector<double> vals(x.size());
+  for(size_t i = 0; i < x.size(); ++i){
+    int id = flatQuadtree->getNodeId(Point(x[i], y[i]));
+    vals[i] = id == -1 ? std::numeric_limits<double>::quiet_NaN() : flatQuadtree->node(id).value;
+  }
+  return vals;
+}
+
+Rcpp::NumericMatrix MappedQuadtreeWrapper::getLayerValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<int> &layers) const{
+  Rcpp::NumericMatrix vals(x.size(), layers.size());
+  for(size_t i = 0; i < x.size(); ++i){
+    int id = flatQuadtree->getNodeId(Point(x[i], y[i]));
+    for(size_t j = 0; j < layers.size(); ++j){
+      vals(i, j) = id == -1 ? std::numeric_limits<double>::quiet_NaN() : flatQuadtree->getLayerValue(id, layers[j]);
+    }
+  }
+  return vals;
+}
+
+Rcpp::NumericMatrix MappedQuadtreeWrapper::getCellsDetails(Rcpp::NumericVector x, Rcpp::NumericVector y) const{
+  Rcpp::NumericMatrix mat(x.length(),6);
+  colnames(mat) = Rcpp::CharacterVector({"id","xmin","xmax","ymin","ymax","value"});
+  for(int i = 0; i < x.length(); ++i){
+    int id = flatQuadtree->getNodeId(Point(x[i],y[i]));
+    if(id != -1){
+      const FlatQuadtree::FlatNode &node = flatQuadtree->node(id);
+      mat(i,0) = id;
+      mat(i,1) = node.xMin;
+      mat(i,2) = node.xMax;
+      mat(i,3) = node.yMin;
+      mat(i,4) = node.yMax;
+      mat(i,5) = node.value;
+    } else {
+      for(int j = 0; j < 6; ++j){
+        mat(i,j) = std::numeric_limits<double>::quiet_NaN();
+      }
+    }
+  }
+  return mat;
+}
+
+// reads the whole tree into a regular 'CppQuadtree'
+QuadtreeWrapper MappedQuadtreeWrapper::toQuadtree() const{
+  const FlatQuadtree::Header &head = flatQuadtree->header();
+  QuadtreeWrapper qw(flatQuadtree->toQuadtree());
+  qw.setOriginalValues(head.originalXMin, head.originalXMax, head.originalYMin, head.originalYMax, head.originalNX, head.originalNY);
+  return qw;
+}
+
+MappedQuadtreeWrapper MappedQuadtreeWrapper::mapQuadtree(std::string filePath){
+  return MappedQuadtreeWrapper(std::make_shared<FlatQuadtree>(filePath));
+}
@@ -0,0 +1,42 @@
+#ifndef MAPPEDQUADTREEWRAPPER_H
+#define MAPPEDQUADTREEWRAPPER_H
+
+#include "FlatQuadtree.h"
+#include "QuadtreeWrapper.h"
+
+#include <Rcpp.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// read-only quadtree that's used directly from a file in the flat format (see
+// 'FlatQuadtree'). The methods have the same names as the corresponding
+// methods of 'QuadtreeWrapper' so that the R code can use either one.
+class MappedQuadtreeWrapper{
+  public:
+    std::shared_ptr<FlatQuadtree> flatQuadtree;
+
+    MappedQuadtreeWrapper(std::shared_ptr<FlatQuadtree> _flatQuadtree);
+
+    int nNodes() const;
+    int nCells() const;
+    double minCellSize() const;
+    Rcpp::NumericVector extent() const;
+    Rcpp::NumericVector originalExtent() const;
+    Rcpp::NumericVector originalDim() const;
+    std::string getProjection() const;
+    std::vector<std::string> getLayerNames() const;
+    int getActiveLayer() const;
+    std::string getValueType() const;
+    std::vector<double> getValues(const std::vector<double> &x, const std::vector<double> &y) const;
+    Rcpp::NumericMatrix getLayerValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<int> &layers) const;
+    Rcpp::NumericMatrix getCellsDetails(Rcpp::NumericVector x, Rcpp::NumericVector y) const;
+    QuadtreeWrapper toQuadtree() const;
+
+    static MappedQuadtreeWrapper mapQuadtree(std::string filePath);
+};
+
+RCPP_EXPOSED_CLASS(MappedQuadtreeWrapper);
+
+#endif
@@ -75,9 +75,8 @@ Matrix Matrix::subset(int rMin, int rMax, int cMin, int cMax) const{
     std::vector<double> sub(nRow*nCol);
     int counter{0};
     for(int i = rMin; i <=rMax; i++){
-        std::vector<double> row_i = getRow(i).asVector();
-        for(int j = cMin; j <= cMax; j++){
-            sub[counter] = row_i[j];
+        for(int j = cMin; j <= cMax; j++){ // read straight from 'vec' rather than copying the whole row first
+            sub[counter] = vec[i * ncol + j];
             counter++;
         }
     }
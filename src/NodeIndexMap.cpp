@@ -0,0 +1,68 @@
+#include "NodeIndexMap.h"
+
+#include <cstdint>
+
+// ------- constructors -------
+NodeIndexMap::NodeIndexMap()
+    : keys(16, -1), values(16, -1){}
+
+// ------- getSlot -------
+// returns the slot where 'key' is stored, or the empty slot where it would be
+// stored if it isn't in the table. The size of the table is always a power of
+// two, so we can use a bitmask instead of the modulo operator.
+size_t NodeIndexMap::getSlot(const int key) const{
+    size_t mask = keys.size() - 1;
+    size_t slot = (static_cast<uint32_t>(key) * 2654435761u) & mask; // multiplicative hashing - spreads out consecutive IDs
+    while(keys[slot] != -1 && keys[slot] != key){
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// ------- grow -------
+// doubles the size of the table and reinserts all of the entries
+void NodeIndexMap::grow(){
+    std::vector<int> oldKeys(keys.size() * 2, -1);
+    std::vector<int> oldValues(values.size() * 2, -1);
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+    for(size_t i = 0; i < oldKeys.size(); ++i){
+        if(oldKeys[i] != -1){
+            size_t slot = getSlot(oldKeys[i]);
+            keys[slot] = oldKeys[i];
+            values[slot] = oldValues[i];
+        }
+    }
+}
+
+// ------- get -------
+// returns the value associated with 'key', or -1 if 'key' isn't in the table
+int NodeIndexMap::get(const int key) const{
+    return values[getSlot(key)];
+}
+
+// ------- set -------
+// associates 'value' with 'key', overwriting the previous value if 'key' is
+// already in the table
+void NodeIndexMap::set(const int key, const int value){
+    size_t slot = getSlot(key);
+    if(keys[slot] == -1){
+        if((nItems + 1) * 2 > static_cast<int>(keys.size())){ // keep the table at most half full - otherwise the probe sequences get long
+            grow();
+            slot = getSlot(key);
+        }
+        keys[slot] = key;
+        nItems++;
+    }
+    values[slot] = value;
+}
+
+int NodeIndexMap::size() const{
+    return nItems;
+}
+
+void NodeIndexMap::clear(){
+    keys.assign(16, -1);
+    values.assign(16, -1);
+    nItems = 0;
+}
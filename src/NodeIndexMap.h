@@ -0,0 +1,33 @@
+#ifndef NODEINDEXMAP_H
+#define NODEINDEXMAP_H
+
+#include <cstddef>
+#include <vector>
+
+// hash table that maps node IDs to indices (for example, the index of the
+// corresponding element in a vector). Uses open addressing with linear
+// probing, so all the entries are stored in two flat vectors rather than
+// allocating memory for each entry like 'std::map' does. The table grows as
+// entries are added, so memory use depends on the number of entries, not on
+// the total number of nodes in the quadtree.
+//
+// Node IDs are never negative, so -1 is used to mark empty slots. Entries
+// can't be removed (other than with 'clear()').
+class NodeIndexMap{
+private:
+    std::vector<int> keys;   // node IDs - -1 means the slot is empty
+    std::vector<int> values; // the index associated with each ID
+    int nItems{0};
+
+    size_t getSlot(const int key) const;
+    void grow();
+public:
+    NodeIndexMap();
+
+    int get(const int key) const;
+    void set(const int key, const int value);
+    int size() const;
+    void clear();
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// ------- getNThreads -------
+// returns the number of threads that are actually worth using - there's no
+// point in spinning up 8 threads to process 10 items
+int parallel::getNThreads(int nThreads, int nItems, int minItemsPerThread){
+    if(minItemsPerThread < 1) minItemsPerThread = 1;
+    int maxThreads = nItems / minItemsPerThread;
+    return std::max(1, std::min(nThreads, maxThreads));
+}
+
+// ------- forRange -------
+// splits the range [0, nItems) into 'nThreads' contiguous chunks and calls
+// 'fun(begin, end, threadIndex)' on each chunk, each on its own thread. If
+// only one thread is requested the function is simply called on the current
+// thread. Any exception thrown inside a thread is rethrown once all threads
+// have finished.
+void parallel::forRange(int nItems, int nThreads, const std::function<void (int, int, int)> &fun){
+    if(nItems <= 0) return;
+    nThreads = getNThreads(nThreads, nItems);
+    if(nThreads == 1){
+        fun(0, nItems, 0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(nThreads);
+    int chunkSize = nItems / nThreads;
+    int remainder = nItems % nThreads;
+    int begin = 0;
+    for(int i = 0; i < nThreads; ++i){
+        int end = begin + chunkSize + (i < remainder ? 1 : 0); // spread the remainder over the first few chunks
+        threads.emplace_back([&fun, &errors, begin, end, i](){
+            try {
+                fun(begin, end, i);
+            } catch(...) {
+                errors[i] = std::current_exception();
+            }
+        });
+        begin = end;
+    }
+    for(auto &thread : threads){
+        thread.join();
+    }
+    for(auto &error : errors){
+        if(error) std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+// small helpers for running loops on multiple threads. Only plain C++ code
+// should be run inside these - nothing in here (or in the functions passed in)
+// is allowed to touch the R API, since R is single-threaded.
+namespace parallel {
+    int getNThreads(int nThreads, int nItems, int minItemsPerThread = 1);
+    void forRange(int nItems, int nThreads, const std::function<void (int, int, int)> &fun);
+}
+
+#endif
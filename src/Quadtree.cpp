@@ -1,9 +1,13 @@
 #include "Quadtree.h"
+#include "ClassCounts.h"
+#include "Parallel.h"
+#include "QuadtreeInfo.h"
 
 #include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <limits>
+#include <stdexcept>
 
 // ------- constructors -------
 Quadtree::Quadtree(double xMin, double xMax, double yMin, double yMax, bool _splitAllNAs, bool _splitAnyNAs)
@@ -59,6 +63,23 @@ bool Quadtree::splitCV(const Matrix &mat, double limit){
     return cv >= limit;
 }
 
+// the next three are for rasters whose values are classes (see 'ClassCounts').
+// 'splitNClasses' splits if there are more than 'limit' classes,
+// 'splitEntropy' splits if the entropy (in bits) of the classes is greater than
+// 'limit', and 'splitPurity' splits if the proportion of values in the most
+// common class is less than 'limit'
+bool Quadtree::splitNClasses(const Matrix &mat, double limit){
+    return ClassCounts(mat).nClasses() > limit;
+}
+
+bool Quadtree::splitEntropy(const Matrix &mat, double limit){
+    return ClassCounts(mat).entropy() > limit;
+}
+
+bool Quadtree::splitPurity(const Matrix &mat, double limit){
+    return ClassCounts(mat).purity() < limit; // false if all the values are NA, since the purity is NaN
+}
+
 // ------- combine* -------
 // these functions are designed to be passed to 'makeTree' and 'makeTreeWithTemplate'.
 // They are responsible for determining the value of a cell in the case where multiple 
@@ -80,6 +101,42 @@ double Quadtree::combineMax(const Matrix &mat){
     return mat.max();
 }
 
+// the most common value - ties go to the smallest value
+double Quadtree::combineMode(const Matrix &mat){
+    return ClassCounts(mat).mode();
+}
+
+// returns the combine function for one of the built-in methods
+std::function<double (const Matrix&)> Quadtree::getCombineFun(const std::string &method){
+    if(method == "mean") return combineMean;
+    if(method == "median") return combineMedian;
+    if(method == "min") return combineMin;
+    if(method == "max") return combineMax;
+    if(method == "mode") return combineMode;
+    throw std::runtime_error("invalid combine method: '" + method + "' - must be 'mean', 'median', 'min', 'max', or 'mode'");
+}
+
+// ------- shouldSplit -------
+// decides whether a node should be split, given the matrix of values it
+// contains. Used by 'makeTree()' and 'restructure()'.
+bool Quadtree::shouldSplit(const Matrix &mat, const std::shared_ptr<Node> node, std::function<bool (const Matrix&)> splitFun) const{
+    // get the dimensions of the cell and the number of Nans
+    double x_length = node->xMax - node->xMin;
+    double y_length = node->yMax - node->yMin;
+    int nNans = mat.countNans();
+    
+    // to split the cell, the following conditions must be met:
+    return (mat.nRow()%2 == 0 && mat.nCol()%2 == 0) // the # of cells in both dimensions must be divisible by two AND
+        && (splitAllNAs || nNans != mat.size()) // (the splitAllNAs option is TRUE OR not all the values are NA) AND
+        && (splitFun(mat) // ( the split function evaluates to TRUE OR
+            || x_length > maxXCellLength // the x side length is greater than the user-defined maximum length OR
+            || y_length > maxYCellLength // the y side length is greater than the user-defined maximum length OR
+            || (splitAnyNAs && nNans > 0) // (the splitAnyNAs option is TRUE AND there is at least one Nan) OR
+            || (splitAllNAs && nNans == mat.size())) // (the splitAllNAs option is TRUE AND all the values are Nan) ) AND
+        && x_length/2 >= minXCellLength // the x length of the quadrant's children would be greater than the min x length AND
+        && y_length/2 >= minYCellLength; // the y length of the quadrant's children would be greater than the min y length
+}
+
 // ------- makeTree -------
 // set of functions used for creating a quadtree
 
@@ -99,22 +156,7 @@ int Quadtree::makeTree(const Matrix &mat, const std::shared_ptr<Node> node, int
 
     int newid{id};
     
-    // get the dimensions of the cell and the number of Nans
-    double x_length = node->xMax - node->xMin;
-    double y_length = node->yMax - node->yMin;
-    int nNans = mat.countNans();
-    
-    // to split the cell, the following conditions must be met:
-    if((mat.nRow()%2 == 0 && mat.nCol()%2 == 0) // the # of cells in both dimensions must be divisible by two AND
-        && (splitAllNAs || nNans != mat.size()) // (the splitAllNAs option is TRUE OR not all the values are NA) AND
-        && (splitFun(mat) // ( the split function evaluates to TRUE OR
-            || x_length > maxXCellLength // the x side length is greater than the user-defined maximum length OR
-            || y_length > maxYCellLength // the y side length is greater than the user-defined maximum length OR
-            || (splitAnyNAs && nNans > 0) // (the splitAnyNAs option is TRUE AND there is at least one Nan) OR
-            || (splitAllNAs && nNans == mat.size())) // (the splitAllNAs option is TRUE AND all the values are Nan) ) AND
-        && x_length/2 >= minXCellLength // the x length of the quadrant's children would be greater than the min x length AND
-        && y_length/2 >= minYCellLength){ // the y length of the quadrant's children would be greater than the min y length
-        
+    if(shouldSplit(mat, node, splitFun)){
         node->hasChildren = true; 
         double cell_x_len = (node->xMax - node->xMin)/2; // get the side length of the cells
         double cell_y_len = (node->yMax - node->yMin)/2;
@@ -167,6 +209,7 @@ void Quadtree::makeTree(const Matrix &mat, std::function<bool (const Matrix&)> s
     if(maxXCellLength < 0) maxXCellLength = root->xMax - root->xMin; 
     if(maxYCellLength < 0) maxYCellLength = root->yMax - root->yMin;
     nNodes = makeTree(mat, root, 0, 0, splitFun, combineFun) + 1; // the ID that is returned from 'makeTree' also corresponds to the number of nodes created. Add 1 to get the count (since the ID starts at 0)
+    pixelIndex.reset();
     assignNeighbors(); // assign neighbors for the cells    
 }
 
@@ -220,6 +263,349 @@ void Quadtree::makeTreeWithTemplate(const Matrix &mat, const std::shared_ptr<Qua
     assignNeighbors();
 }
 
+// faster version of 'makeTreeWithTemplate()' for the built-in combine methods
+// and for combine functions that can be run on more than one thread. Since
+// the structure is already known, the new quadtree starts out sharing the
+// template's nodes (as if it was a copy - see 'detach()'), and the values of
+// every node are calculated with 'getLayerValues()' - for the built-in
+// methods this is one pass over 'mat' instead of subsetting 'mat' at every
+// node.
+void Quadtree::makeTreeWithTemplate(const Matrix &mat, const std::shared_ptr<Quadtree> templateQuadtree, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads){
+    shareTemplate(mat, templateQuadtree);
+    setNodeValues(getLayerValues(mat, combineMethod, combineFun, nThreads)); // gives this quadtree its own nodes
+}
+
+// same as above, but 'combineFun' is given every node at a level at once
+// (see 'getLayerValuesByLevel()')
+void Quadtree::makeTreeWithTemplate(const Matrix &mat, const std::shared_ptr<Quadtree> templateQuadtree, const std::function<std::vector<double> (const std::vector<Matrix>&)> &combineFun){
+    shareTemplate(mat, templateQuadtree);
+    setNodeValues(getLayerValuesByLevel(mat, combineFun));
+}
+
+// makes this quadtree share the structure of 'templateQuadtree' (the nodes
+// are only copied once the values are set)
+void Quadtree::shareTemplate(const Matrix &mat, const std::shared_ptr<Quadtree> templateQuadtree){
+    if(mat.nCol() != templateQuadtree->matNX || mat.nRow() != templateQuadtree->matNY){
+        throw std::runtime_error("The dimensions of 'mat' (" + std::to_string(mat.nRow()) + " rows, " + std::to_string(mat.nCol()) + " cols) must be identical to the dimensions of the original matrix used to create 'templateQuadtree' (" + std::to_string(templateQuadtree->matNY) + " rows, " + std::to_string(templateQuadtree->matNX) + " cols)");
+    }
+    matNX = templateQuadtree->matNX;
+    matNY = templateQuadtree->matNY;
+    maxXCellLength = templateQuadtree->maxXCellLength;
+    maxYCellLength = templateQuadtree->maxYCellLength;
+    nNodes = templateQuadtree->nNodes;
+    projection = templateQuadtree->projection;
+
+    root = templateQuadtree->root;
+    pixelIndex = templateQuadtree->getPixelIndex();
+}
+
+// same as 'makeTree()', but the decision to split is made using several
+// matrices (one per layer) at once - 'splitFun' is given the part of each
+// matrix that the node contains. The checks for NAs and cell sizes in
+// 'shouldSplit()' use the first matrix. Only the structure is created - the
+// values need to be added afterwards with 'setLayers()'.
+int Quadtree::makeTree(const std::vector<Matrix> &mats, const std::shared_ptr<Node> node, int id, int level, const std::function<bool (const std::vector<Matrix>&)> &splitFun){
+    node->level = level;
+    node->id = id;
+
+    int newid{id};
+    if(shouldSplit(mats[0], node, [&mats, &splitFun](const Matrix&){ return splitFun(mats); })){
+        node->hasChildren = true;
+        double cell_x_len = (node->xMax - node->xMin)/2;
+        double cell_y_len = (node->yMax - node->yMin)/2;
+        std::vector<Matrix> subs(mats.size());
+        for(int r = 0; r < 2; ++r){
+            for(int c = 0; c < 2; ++c){
+                int c_beg = (mats[0].nCol()/2)*c;
+                int c_end = (c_beg + mats[0].nCol()/2)-1;
+                int r_beg = (mats[0].nRow()/2)*r;
+                int r_end = (r_beg + mats[0].nRow()/2)-1;
+
+                double x_min = node->xMin + c*cell_x_len;
+                double x_max = x_min + cell_x_len;
+                double y_min = node->yMin + (1-r)*cell_y_len;
+                double y_max = y_min + cell_y_len;
+
+                int childIndex = (1-r)*2 + c;
+                for(size_t i = 0; i < mats.size(); ++i){
+                    subs[i] = mats[i].subset(r_beg,r_end,c_beg,c_end);
+                }
+                node->children.at(childIndex) = std::make_shared<Node>(x_min, x_max, y_min, y_max, -1, -1, -1);
+                newid = makeTree(subs, node->children[childIndex], newid+1, level+1, splitFun);
+            }
+        }
+        for(size_t i = 0; i < node->children.size(); ++i){
+            if(node->children[i]->smallestChildSideLength < node->smallestChildSideLength){
+                node->smallestChildSideLength = node->children[i]->smallestChildSideLength;
+            }
+        }
+    }
+    return newid;
+}
+
+void Quadtree::makeTree(const std::vector<Matrix> &mats, const std::function<bool (const std::vector<Matrix>&)> &splitFun){
+    for(auto const &mat : mats){
+        if(mat.nCol() != mats[0].nCol() || mat.nRow() != mats[0].nRow()){
+            throw std::runtime_error("all of the matrices must have the same dimensions");
+        }
+    }
+    matNX = mats[0].nCol();
+    matNY = mats[0].nRow();
+    if(maxXCellLength < 0) maxXCellLength = root->xMax - root->xMin;
+    if(maxYCellLength < 0) maxYCellLength = root->yMax - root->yMin;
+    nNodes = makeTree(mats, root, 0, 0, splitFun) + 1;
+    pixelIndex.reset();
+    assignNeighbors();
+}
+
+// ------- makeTreeByLevel -------
+// same as 'makeTree()', but the tree is built one level at a time rather than
+// one node at a time, so 'splitFun' and 'combineFun' are only called once per
+// level. This is meant for functions that have a large overhead per call
+// (i.e. R functions) - the tree is identical to the one 'makeTree()' creates.
+// PARAMETERS:
+//   mats -> one matrix per layer. The checks for NAs and cell sizes in
+//      'shouldSplit()' use the first matrix
+//   splitFun -> given the matrices of every quadrant at a level that could be
+//      split (i.e. every quadrant 'shouldSplit()' would call the split function
+//      on) and returns whether or not to split each one
+//   combineFun -> given the first matrix of every node at a level and returns
+//      the value of each one. If null, the values aren't set, and need to be
+//      added afterwards with 'setLayers()'
+void Quadtree::makeTreeByLevel(const std::vector<Matrix> &mats, const std::function<std::vector<bool> (const std::vector<std::vector<Matrix>>&)> &splitFun, const std::function<std::vector<double> (const std::vector<Matrix>&)> &combineFun){
+    for(auto const &mat : mats){
+        if(mat.nCol() != mats[0].nCol() || mat.nRow() != mats[0].nRow()){
+            throw std::runtime_error("all of the matrices must have the same dimensions");
+        }
+    }
+    matNX = mats[0].nCol();
+    matNY = mats[0].nRow();
+    if(maxXCellLength < 0) maxXCellLength = root->xMax - root->xMin;
+    if(maxYCellLength < 0) maxYCellLength = root->yMax - root->yMin;
+
+    std::vector<std::shared_ptr<Node>> allNodes; // every node, in the order they were created (so parents come before their children)
+    std::vector<std::shared_ptr<Node>> nodes{root}; // the nodes at the current level
+    std::vector<std::vector<Matrix>> nodeMats{mats}; // the matrices contained by each node at the current level
+    for(int level = 0; !nodes.empty(); ++level){
+        if(combineFun){
+            std::vector<Matrix> firstMats;
+            firstMats.reserve(nodes.size());
+            for(auto const &nodeMat : nodeMats){
+                firstMats.push_back(nodeMat[0]);
+            }
+            std::vector<double> vals = combineFun(firstMats);
+            if(vals.size() != nodes.size()){
+                throw std::runtime_error("the combine function returned " + std::to_string(vals.size()) + " values for " + std::to_string(nodes.size()) + " cells");
+            }
+            for(size_t i = 0; i < nodes.size(); ++i){
+                nodes[i]->value = vals[i];
+            }
+        }
+
+        // 'shouldSplit()' only calls the split function if the other
+        // conditions allow the node to be split - call it once to find those
+        // nodes, then call it again with the results of 'splitFun'
+        std::vector<int> candidates;
+        for(size_t i = 0; i < nodes.size(); ++i){
+            nodes[i]->level = level;
+            allNodes.push_back(nodes[i]);
+            shouldSplit(nodeMats[i][0], nodes[i], [&candidates, i](const Matrix&){ candidates.push_back(i); return false; });
+        }
+        std::vector<bool> split(nodes.size(), false);
+        if(!candidates.empty()){
+            std::vector<std::vector<Matrix>> candidateMats;
+            candidateMats.reserve(candidates.size());
+            for(int i : candidates){
+                candidateMats.push_back(nodeMats[i]);
+            }
+            std::vector<bool> results = splitFun(candidateMats);
+            if(results.size() != candidates.size()){
+                throw std::runtime_error("the split function returned " + std::to_string(results.size()) + " values for " + std::to_string(candidates.size()) + " cells");
+            }
+            for(size_t i = 0; i < candidates.size(); ++i){
+                split[candidates[i]] = results[i];
+            }
+        }
+
+        std::vector<std::shared_ptr<Node>> nextNodes;
+        std::vector<std::vector<Matrix>> nextMats;
+        for(size_t i = 0; i < nodes.size(); ++i){
+            std::shared_ptr<Node> node = nodes[i];
+            const std::vector<Matrix> &nodeMat = nodeMats[i];
+            if(!shouldSplit(nodeMat[0], node, [&split, i](const Matrix&){ return split[i]; })) continue;
+            node->hasChildren = true;
+            double cell_x_len = (node->xMax - node->xMin)/2;
+            double cell_y_len = (node->yMax - node->yMin)/2;
+            for(int r = 0; r < 2; ++r){
+                for(int c = 0; c < 2; ++c){
+                    int c_beg = (nodeMat[0].nCol()/2)*c;
+                    int c_end = (c_beg + nodeMat[0].nCol()/2)-1;
+                    int r_beg = (nodeMat[0].nRow()/2)*r;
+                    int r_end = (r_beg + nodeMat[0].nRow()/2)-1;
+
+                    double x_min = node->xMin + c*cell_x_len;
+                    double x_max = x_min + cell_x_len;
+                    double y_min = node->yMin + (1-r)*cell_y_len;
+                    double y_max = y_min + cell_y_len;
+
+                    int childIndex = (1-r)*2 + c;
+                    std::vector<Matrix> subs(nodeMat.size());
+                    for(size_t j = 0; j < nodeMat.size(); ++j){
+                        subs[j] = nodeMat[j].subset(r_beg,r_end,c_beg,c_end);
+                    }
+                    node->children.at(childIndex) = std::make_shared<Node>(x_min, x_max, y_min, y_max, -1, -1, -1);
+                    nextNodes.push_back(node->children[childIndex]);
+                    nextMats.push_back(std::move(subs));
+                }
+            }
+        }
+        nodes.swap(nextNodes);
+        nodeMats.swap(nextMats);
+    }
+
+    // children come after their parents, so going backwards means every
+    // node's children are finished before it is
+    for(auto it = allNodes.rbegin(); it != allNodes.rend(); ++it){
+        Node *node = it->get();
+        if(!node->hasChildren) continue;
+        for(auto const &child : node->children){
+            if(child->smallestChildSideLength < node->smallestChildSideLength){
+                node->smallestChildSideLength = child->smallestChildSideLength;
+            }
+        }
+    }
+    nNodes = assignIds(root, 0) + 1; // use the same IDs as 'makeTree()'
+    pixelIndex.reset();
+    assignNeighbors();
+}
+
+// ------- restructure -------
+// updates the structure of the tree after the values in some parts of the
+// matrix used to create it have changed, without rebuilding the whole tree.
+// Only the nodes that contain at least one of the edited points are
+// re-evaluated - every other node contains the same values as before, so the
+// split rule would give the same answer for it. Going down from the root, each
+// of these nodes gets a new value, and then:
+//   * if it has children but the split rule now says it shouldn't be split,
+//     its children are removed (merged into a single cell)
+//   * if it doesn't have children but the split rule now says it should be
+//     split, it's split (recursively, as in 'makeTree()')
+//   * otherwise we move on to the children that contain edited points
+// Afterwards the IDs are reassigned (in the same order 'makeTree()' uses) and
+// the neighbors are only recalculated for the nodes that touch a cell that
+// was split or merged.
+// PARAMETERS:
+//   mat -> the new matrix - must have the same dimensions as the matrix that
+//      was used to create the tree
+//   pts -> the locations of the edited values
+//   splitFun, combineFun -> same as for 'makeTree()'
+// RETURNS: the number of nodes that were split or merged
+int Quadtree::restructure(const Matrix &mat, const std::vector<Point> &pts, std::function<bool (const Matrix&)> splitFun, std::function<double (const Matrix&)> combineFun){
+    if(mat.nCol() != matNX || mat.nRow() != matNY){
+        throw std::runtime_error("The dimensions of 'mat' (" + std::to_string(mat.nRow()) + " rows, " + std::to_string(mat.nCol()) + " cols) must be identical to the dimensions of the matrix used to create the quadtree (" + std::to_string(matNY) + " rows, " + std::to_string(matNX) + " cols)");
+    }
+    std::vector<Point> ptsInside;
+    for(auto const &pt : pts){
+        if(getNode(pt, root)) ptsInside.push_back(pt);
+    }
+    std::vector<std::shared_ptr<Node>> changed;
+    if(!ptsInside.empty()){
+        if(!layers.empty()){
+            throw std::runtime_error("quadtrees with more than one layer can't be restructured");
+        }
+        detach();
+        restructure(mat, root, ptsInside, splitFun, combineFun, changed);
+    }
+    if(changed.empty()){
+        return 0;
+    }
+    nNodes = assignIds(root, 0) + 1;
+    pixelIndex.reset();
+
+    // find every node (at any level) that touches one of the changed cells -
+    // these are the only nodes whose neighbors could have changed
+    std::vector<std::shared_ptr<Node>> touching;
+    std::function<void (const std::shared_ptr<Node>&, const Node&)> findTouching = [&](const std::shared_ptr<Node> &node, const Node &box){
+        if(node->xMax < box.xMin || node->xMin > box.xMax || node->yMax < box.yMin || node->yMin > box.yMax) return;
+        touching.push_back(node);
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                findTouching(child, box);
+            }
+        }
+    };
+    for(auto const &node : changed){
+        findTouching(root, *node);
+    }
+    std::sort(touching.begin(), touching.end());
+    touching.erase(std::unique(touching.begin(), touching.end()), touching.end());
+    for(auto const &node : touching){
+        auto neighbors = findNeighbors(node, root->smallestChildSideLength);
+        node->neighbors = std::vector<std::weak_ptr<Node>>(neighbors.begin(), neighbors.end());
+    }
+    return changed.size();
+}
+
+// recursive helper for 'restructure()'
+// PARAMETERS:
+//   mat -> the part of the matrix covered by 'node'
+//   node -> the node to re-evaluate
+//   pts -> the edited points that fall in 'node'
+//   changed -> the nodes that are split or merged are added to this
+void Quadtree::restructure(const Matrix &mat, const std::shared_ptr<Node> node, const std::vector<Point> &pts, std::function<bool (const Matrix&)> splitFun, std::function<double (const Matrix&)> combineFun, std::vector<std::shared_ptr<Node>> &changed){
+    bool split = shouldSplit(mat, node, splitFun);
+    if(!node->hasChildren && split){
+        makeTree(mat, node, node->id, node->level, splitFun, combineFun); // the IDs are fixed afterwards
+        changed.push_back(node);
+        return;
+    }
+    node->value = combineFun(mat);
+    if(!node->hasChildren){
+        return;
+    }
+    if(!split){ // merge the children
+        node->hasChildren = false;
+        node->children = std::vector<std::shared_ptr<Node>>(4);
+        node->smallestChildSideLength = node->xMax - node->xMin;
+        changed.push_back(node);
+        return;
+    }
+    for(int r = 0; r < 2; ++r){
+        for(int c = 0; c < 2; ++c){
+            int childIndex = (1-r)*2 + c;
+            std::shared_ptr<Node> child = node->children[childIndex];
+            std::vector<Point> childPts;
+            for(auto const &pt : pts){
+                if(node->getChildIndex(pt) == childIndex) childPts.push_back(pt);
+            }
+            if(childPts.empty()) continue;
+            int c_beg = (mat.nCol()/2)*c;
+            int r_beg = (mat.nRow()/2)*r;
+            Matrix sub = mat.subset(r_beg, r_beg + mat.nRow()/2 - 1, c_beg, c_beg + mat.nCol()/2 - 1);
+            restructure(sub, child, childPts, splitFun, combineFun, changed);
+        }
+    }
+    node->smallestChildSideLength = node->xMax - node->xMin;
+    for(auto const &child : node->children){
+        node->smallestChildSideLength = std::min(node->smallestChildSideLength, child->smallestChildSideLength);
+    }
+}
+
+// ------- assignIds -------
+// gives each node an ID, in the same order as 'makeTree()'
+// RETURNS: the largest ID that was assigned
+int Quadtree::assignIds(const std::shared_ptr<Node> node, int id){
+    node->id = id;
+    if(node->hasChildren){
+        for(int r = 0; r < 2; ++r){
+            for(int c = 0; c < 2; ++c){
+                id = assignIds(node->children[(1-r)*2 + c], id + 1);
+            }
+        }
+    }
+    return id;
+}
+
 // ------- findNeighbors -------
 // finds which nodes are adjacent to this node
 // operates by creating a set of points just outside the boundary of the node 
@@ -310,6 +696,34 @@ std::shared_ptr<Node> Quadtree::getNode(const Point pt) const{
     return getNode(pt, root);
 }
 
+// ------- getNode (by ID) -------
+// returns the node with the given ID. Node IDs are assigned in the order the
+// nodes are created when the tree is built (i.e. a preorder traversal), so the
+// node we're looking for has to be a descendant of the child with the largest
+// ID that's still less than or equal to 'id'. This lets us go straight down
+// the tree rather than searching every node.
+std::shared_ptr<Node> Quadtree::getNode(const int id, const std::shared_ptr<Node> node) const{
+    if(node->id == id){
+        return node;
+    }
+    if(node->hasChildren){
+        std::shared_ptr<Node> next{nullptr};
+        for(size_t i = 0; i < node->children.size(); ++i){
+            if(node->children[i]->id <= id && (!next || node->children[i]->id > next->id)){
+                next = node->children[i];
+            }
+        }
+        if(next){
+            return getNode(id, next);
+        }
+    }
+    return nullptr; // no node with this ID
+}
+
+std::shared_ptr<Node> Quadtree::getNode(const int id) const{
+    return getNode(id, root);
+}
+
 // ------- getValue -------
 // uses 'getNode' to return only the value of a node
 double Quadtree::getValue(const Point pt) const{
@@ -359,12 +773,72 @@ std::list<std::shared_ptr<Node>> Quadtree::getNodesInBox(double xMin, double xMa
 // ------- setValue -------
 // given a point and a value, change the value of the node that the point falls in
 void Quadtree::setValue(const Point pt, double newValue){
+    detach();
     std::shared_ptr<Node> node = getNode(pt,root);
     if(node){
         node->value = newValue;
     }
 }
 
+// ------- setValues -------
+// changes the values of the nodes that a set of points fall in. The values are
+// changed in order, so if more than one point falls in the same node, the
+// node gets the last value. If 'combineFun' is given, the values of the
+// ancestors of the changed nodes are then recalculated (see
+// 'updateAncestors()').
+void Quadtree::setValues(const std::vector<Point> &pts, const std::vector<double> &newValues, std::function<double (const Matrix&)> combineFun){
+    detach();
+    std::vector<std::shared_ptr<Node>> ancestors;
+    for(size_t i = 0; i < pts.size(); ++i){
+        std::shared_ptr<Node> node = getNode(pts[i], root);
+        if(!node) continue;
+        node->value = newValues[i];
+        if(!combineFun) continue;
+        // go down from the root to record the ancestors of the node
+        std::shared_ptr<Node> ancestor = root;
+        while(ancestor->hasChildren){
+            ancestors.push_back(ancestor);
+            ancestor = ancestor->children[ancestor->getChildIndex(pts[i])];
+        }
+    }
+    if(combineFun){
+        updateAncestors(ancestors, combineFun);
+    }
+}
+
+// ------- updateAncestors -------
+// recalculates the values of a set of nodes from the values of their
+// children. The nodes are processed from the deepest to the shallowest, so a
+// node is always updated after its children, and each node is only updated
+// once even if it's in 'nodes' many times. This takes O(k log n) time for k
+// changed leaves rather than the O(n) needed to rebuild the tree.
+// Since the original matrix isn't available, the value of a node is 'combineFun'
+// applied to the values of its four children (rather than to all the values
+// it contains) - for "min" and "max" this gives the same result, and for
+// "mean" it does as long as none of the children are partly NA (since the
+// children are weighted equally rather than by their number of non-NA
+// values). For "median" and "mode" it doesn't, so these shouldn't be used.
+// 'detach()' must be called before the nodes are collected, since otherwise
+// they could belong to another copy of the quadtree.
+// PARAMETERS:
+//   nodes -> the nodes to update (this is sorted in place). Nodes without
+//      children are ignored
+//   combineFun -> function used to combine the values of the children
+void Quadtree::updateAncestors(std::vector<std::shared_ptr<Node>> &nodes, std::function<double (const Matrix&)> combineFun){
+    std::sort(nodes.begin(), nodes.end(), [](const std::shared_ptr<Node> &a, const std::shared_ptr<Node> &b){
+        return a->level > b->level || (a->level == b->level && a < b);
+    });
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    std::vector<double> vals(4);
+    for(auto const &node : nodes){
+        if(!node->hasChildren) continue;
+        for(size_t i = 0; i < node->children.size(); ++i){
+            vals[i] = node->children[i]->value;
+        }
+        node->value = combineFun(Matrix(vals, 2, 2));
+    }
+}
+
 // ------- transformValues -------
 // modify the values of all cells using a function
 void Quadtree::transformValues(std::shared_ptr<Node> node, std::function<double (const double)> &transformFun){
@@ -376,44 +850,646 @@ void Quadtree::transformValues(std::shared_ptr<Node> node, std::function<double
     }
 }
 void Quadtree::transformValues(std::function<double (const double)> &transformFun){
+    detach();
     transformValues(root, transformFun);
 }
 
-// ------- copyNode -------
-// creates a deep copy of a node
-int Quadtree::copyNode(std::shared_ptr<Node> nodeCopy, const std::shared_ptr<Node> nodeOrig) const{
-    nodeCopy->xMin = nodeOrig->xMin;
-    nodeCopy->xMax = nodeOrig->xMax;
-    nodeCopy->yMin = nodeOrig->yMin;
-    nodeCopy->yMax = nodeOrig->yMax;
-    nodeCopy->value = nodeOrig->value;
-    nodeCopy->id = nodeOrig->id;
-    nodeCopy->level = nodeOrig->level;
-    nodeCopy->smallestChildSideLength = nodeOrig->smallestChildSideLength;
-    nodeCopy->hasChildren = nodeOrig->hasChildren;
-
-    int newid{nodeOrig->id};
-    if(nodeOrig->hasChildren){
+// same as 'transformValues()', but the values of all the nodes are copied into
+// a single vector (in the same order as 'toVector()') and 'transformFun' is
+// called once on the whole vector, which must be modified in place. Then the
+// new values are copied back into the nodes.
+void Quadtree::transformValuesVector(const std::function<void (std::vector<double>&)> &transformFun){
+    detach();
+    std::vector<Node*> nodes;
+    nodes.reserve(nNodes);
+    std::vector<Node*> stack{root.get()};
+    while(!stack.empty()){
+        Node *node = stack.back();
+        stack.pop_back();
+        nodes.push_back(node);
+        if(node->hasChildren){
+            for(auto itr = node->children.rbegin(); itr != node->children.rend(); ++itr){ // reversed so the children come off the stack in order
+                stack.push_back(itr->get());
+            }
+        }
+    }
+    std::vector<double> vals(nodes.size());
+    for(size_t i = 0; i < nodes.size(); ++i){
+        vals[i] = nodes[i]->value;
+    }
+    transformFun(vals);
+    if(vals.size() != nodes.size()){
+        throw std::runtime_error("the transformation returned " + std::to_string(vals.size()) + " values, but the quadtree has " + std::to_string(nodes.size()) + " nodes");
+    }
+    for(size_t i = 0; i < nodes.size(); ++i){
+        nodes[i]->value = vals[i];
+    }
+}
+
+// ------- layers -------
+// functions for quadtrees with more than one layer of values (see 'layers' in
+// 'Quadtree.h')
+
+int Quadtree::nLayers() const{
+    return layers.empty() ? 1 : layers.size();
+}
+
+// ------- getPixelIndex -------
+// returns the 'PixelIndex' of the quadtree, creating it if it doesn't exist.
+// The rows and columns of the matrix covered by each node are found using the
+// same rule as 'makeTree()' (each child gets half of its parent's rows and
+// columns).
+std::shared_ptr<const Quadtree::PixelIndex> Quadtree::getPixelIndex(){
+    if(pixelIndex) return pixelIndex;
+
+    // find the block of the matrix covered by each leaf (rows and columns are
+    // [min, max))
+    struct Block{
+        int rMin, rMax, cMin, cMax, id;
+    };
+    std::vector<Block> leaves;
+    std::vector<std::pair<const Node*, Block>> stack{{root.get(), Block{0, matNY, 0, matNX, root->id}}};
+    while(!stack.empty()){
+        const Node *node = stack.back().first;
+        Block block = stack.back().second;
+        stack.pop_back();
+        if(node->id < 0 || node->id >= nNodes){
+            throw std::runtime_error("node IDs must be between 0 and the number of nodes minus one");
+        }
+        if(!node->hasChildren){
+            leaves.push_back(block);
+            continue;
+        }
+        int nRowHalf = (block.rMax - block.rMin)/2;
+        int nColHalf = (block.cMax - block.cMin)/2;
         for(int r = 0; r < 2; ++r){
             for(int c = 0; c < 2; ++c){
-                int childIndex = (1-r)*2 + c; // get the index (from 0 to 3) of this child 
-                nodeCopy->children.at(childIndex) = std::make_shared<Node>();
-                newid = copyNode(nodeCopy->children[childIndex],nodeOrig->children[childIndex]);
+                const Node *child = node->children[(1-r)*2 + c].get();
+                int rMin = block.rMin + nRowHalf*r;
+                int cMin = block.cMin + nColHalf*c;
+                stack.push_back({child, Block{rMin, rMin + nRowHalf, cMin, cMin + nColHalf, child->id}});
             }
         }
     }
-    return newid;
+
+    // a leaf adds one run to each of its rows
+    auto index = std::make_shared<PixelIndex>();
+    index->rowOffsets.assign(matNY + 1, 0);
+    for(auto const &leaf : leaves){
+        for(int row = leaf.rMin; row < leaf.rMax; ++row){
+            ++index->rowOffsets[row + 1];
+        }
+    }
+    for(int row = 0; row < matNY; ++row){
+        index->rowOffsets[row + 1] += index->rowOffsets[row];
+    }
+    std::vector<std::pair<int, int>> runs(index->rowOffsets.back()); // column the run starts at, and its index in 'leaves'
+    std::vector<int> next(index->rowOffsets.begin(), index->rowOffsets.end() - 1);
+    for(size_t i = 0; i < leaves.size(); ++i){
+        for(int row = leaves[i].rMin; row < leaves[i].rMax; ++row){
+            runs[next[row]++] = std::make_pair(leaves[i].cMin, i);
+        }
+    }
+    index->colEnds.resize(runs.size());
+    index->leafIds.resize(runs.size());
+    for(int row = 0; row < matNY; ++row){
+        std::sort(runs.begin() + index->rowOffsets[row], runs.begin() + index->rowOffsets[row + 1]);
+        int col{0};
+        for(int k = index->rowOffsets[row]; k < index->rowOffsets[row + 1]; ++k){
+            const Block &leaf = leaves[runs[k].second];
+            if(leaf.cMin != col){
+                throw std::runtime_error("the leaves of the quadtree don't cover row " + std::to_string(row) + " of the matrix");
+            }
+            col = leaf.cMax;
+            index->colEnds[k] = leaf.cMax;
+            index->leafIds[k] = leaf.id;
+        }
+        if(col != matNX){
+            throw std::runtime_error("the leaves of the quadtree don't cover row " + std::to_string(row) + " of the matrix");
+        }
+    }
+    pixelIndex = index;
+    return pixelIndex;
+}
+
+// ------- getNodeValues -------
+// calculates the value of every node for a matrix with the same dimensions as
+// the one used to create the quadtree, using one of the built-in combine
+// methods. Rather than subsetting the matrix at every node, the matrix is read
+// once, row by row, and each value is added to the leaf that contains it (see
+// 'PixelIndex'). The values of the larger cells are then calculated from
+// their children, so this takes time proportional to the size of the matrix
+// plus the number of nodes.
+//   * "mean", "min", "max" -> each leaf gets a sum and count (or a min or max).
+//      The rows are split between the threads, and each thread keeps its own
+//      totals, which are added together afterwards
+//   * "median" -> the values are grouped by leaf (with the leaves in
+//      depth-first order, so the values in every node are next to each other)
+//      and the median of each node is found with 'std::nth_element()'. The
+//      nodes are split between the threads
+//   * "mode" -> the values are grouped by leaf as for "median", and a
+//      histogram of the classes in each leaf is made (see 'ClassCounts'). The
+//      histogram of every other node is the sum of its children's
+// The results are the same as using 'combineFun' on the matrix contained by
+// each node (apart from rounding error in the means).
+// RETURNS: the value of each node, indexed by node ID
+std::vector<double> Quadtree::getNodeValues(const Matrix &mat, const std::string &combineMethod, int nThreads){
+    if(combineMethod != "mean" && combineMethod != "median" && combineMethod != "min" && combineMethod != "max" && combineMethod != "mode"){
+        throw std::runtime_error("invalid combine method: '" + combineMethod + "' - must be 'mean', 'median', 'min', 'max', or 'mode'");
+    }
+    if(mat.nCol() != matNX || mat.nRow() != matNY){
+        throw std::runtime_error("The dimensions of the matrix (" + std::to_string(mat.nRow()) + " rows, " + std::to_string(mat.nCol()) + " cols) must be identical to the dimensions of the matrix used to create the quadtree (" + std::to_string(matNY) + " rows, " + std::to_string(matNX) + " cols)");
+    }
+    std::shared_ptr<const PixelIndex> index = getPixelIndex();
+
+    // get the nodes in depth-first order - every node comes before its
+    // descendants, and the descendants of a node are next to each other
+    std::vector<const Node*> nodes;
+    nodes.reserve(nNodes);
+    std::vector<const Node*> stack{root.get()};
+    while(!stack.empty()){
+        const Node *node = stack.back();
+        stack.pop_back();
+        nodes.push_back(node);
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                stack.push_back(child.get());
+            }
+        }
+    }
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> vals(nNodes, nan);
+
+    if(combineMethod == "median" || combineMethod == "mode"){
+        // count the (non-NA) values in each leaf and use the counts to find
+        // where each node's values start and end
+        std::vector<int> counts(nNodes, 0);
+        for(int row = 0; row < matNY; ++row){
+            int col{0};
+            for(int k = index->rowOffsets[row]; k < index->rowOffsets[row + 1]; ++k){
+                for(; col < index->colEnds[k]; ++col){
+                    if(!std::isnan(mat.vec[row*matNX + col])) ++counts[index->leafIds[k]];
+                }
+            }
+        }
+        std::vector<int> begins(nNodes, 0), ends(nNodes, 0);
+        int total{0};
+        for(const Node *node : nodes){
+            if(node->hasChildren) continue;
+            begins[node->id] = total;
+            total += counts[node->id];
+            ends[node->id] = total;
+        }
+        for(auto itr = nodes.rbegin(); itr != nodes.rend(); ++itr){ // descendants come after their ancestors
+            const Node *node = *itr;
+            if(!node->hasChildren) continue;
+            begins[node->id] = total;
+            ends[node->id] = 0;
+            for(auto const &child : node->children){
+                begins[node->id] = std::min(begins[node->id], begins[child->id]);
+                ends[node->id] = std::max(ends[node->id], ends[child->id]);
+            }
+        }
+
+        std::vector<double> sorted(total); // the values, grouped by leaf
+        std::vector<int> next(begins);
+        for(int row = 0; row < matNY; ++row){
+            int col{0};
+            for(int k = index->rowOffsets[row]; k < index->rowOffsets[row + 1]; ++k){
+                for(; col < index->colEnds[k]; ++col){
+                    double val = mat.vec[row*matNX + col];
+                    if(!std::isnan(val)) sorted[next[index->leafIds[k]]++] = val;
+                }
+            }
+        }
+        if(combineMethod == "mode"){
+            // the histogram of each leaf is made from its values, and the
+            // histogram of every other node is the sum of its children's
+            std::vector<ClassCounts> hists(nNodes);
+            parallel::forRange(nodes.size(), parallel::getNThreads(nThreads, nodes.size(), 64), [&](int begin, int end, int){
+                for(int i = begin; i < end; ++i){
+                    if(nodes[i]->hasChildren) continue;
+                    int id = nodes[i]->id;
+                    hists[id] = ClassCounts(std::vector<double>(sorted.begin() + begins[id], sorted.begin() + ends[id]));
+                }
+            });
+            for(auto itr = nodes.rbegin(); itr != nodes.rend(); ++itr){ // descendants come after their ancestors
+                const Node *node = *itr;
+                ClassCounts &hist = hists[node->id];
+                if(node->hasChildren){
+                    for(auto const &child : node->children){
+                        hist.add(hists[child->id]);
+                        hists[child->id] = ClassCounts(); // the child's mode has already been found, so we don't need it anymore
+                    }
+                }
+                vals[node->id] = hist.mode();
+            }
+            return vals;
+        }
+        parallel::forRange(nodes.size(), parallel::getNThreads(nThreads, nodes.size(), 64), [&](int begin, int end, int){
+            std::vector<double> buffer;
+            for(int i = begin; i < end; ++i){
+                int id = nodes[i]->id;
+                int n = ends[id] - begins[id];
+                if(n == 0) continue;
+                buffer.assign(sorted.begin() + begins[id], sorted.begin() + ends[id]);
+                std::nth_element(buffer.begin(), buffer.begin() + n/2, buffer.end());
+                double upper = buffer[n/2];
+                vals[id] = n%2 == 1 ? upper : (upper + *std::max_element(buffer.begin(), buffer.begin() + n/2)) / 2;
+            }
+        });
+        return vals;
+    }
+
+    // "mean", "min", or "max" - 'stats' is the sum, min, or max of each node
+    bool isMin = combineMethod == "min";
+    bool isMax = combineMethod == "max";
+    double init = isMin ? std::numeric_limits<double>::infinity() : (isMax ? -std::numeric_limits<double>::infinity() : 0);
+    nThreads = parallel::getNThreads(nThreads, matNY, 64);
+    std::vector<std::vector<double>> threadStats(nThreads);
+    std::vector<std::vector<double>> threadCounts(nThreads);
+    parallel::forRange(matNY, nThreads, [&](int begin, int end, int thread){
+        std::vector<double> &stats = threadStats[thread];
+        std::vector<double> &counts = threadCounts[thread];
+        stats.assign(nNodes, init);
+        counts.assign(nNodes, 0);
+        for(int row = begin; row < end; ++row){
+            const double *rowVals = mat.vec.data() + static_cast<size_t>(row)*matNX;
+            int col{0};
+            for(int k = index->rowOffsets[row]; k < index->rowOffsets[row + 1]; ++k){
+                int id = index->leafIds[k];
+                double stat = stats[id];
+                double n{0};
+                for(; col < index->colEnds[k]; ++col){
+                    double val = rowVals[col];
+                    if(isMin){
+                        if(val < stat) stat = val; // NaN comparisons are always false, so NAs are ignored (as in 'Matrix::min()')
+                    } else if(isMax){
+                        if(val > stat) stat = val;
+                    } else if(!std::isnan(val)){
+                        stat += val;
+                        ++n;
+                    }
+                }
+                stats[id] = stat;
+                counts[id] += n;
+            }
+        }
+    });
+    std::vector<double> &stats = threadStats[0];
+    std::vector<double> &counts = threadCounts[0];
+    for(int t = 1; t < nThreads; ++t){
+        for(int id = 0; id < nNodes; ++id){
+            if(isMin) stats[id] = std::min(stats[id], threadStats[t][id]);
+            else if(isMax) stats[id] = std::max(stats[id], threadStats[t][id]);
+            else stats[id] += threadStats[t][id];
+            counts[id] += threadCounts[t][id];
+        }
+    }
+    for(auto itr = nodes.rbegin(); itr != nodes.rend(); ++itr){ // descendants come after their ancestors
+        const Node *node = *itr;
+        int id = node->id;
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                if(isMin) stats[id] = std::min(stats[id], stats[child->id]);
+                else if(isMax) stats[id] = std::max(stats[id], stats[child->id]);
+                else stats[id] += stats[child->id];
+                counts[id] += counts[child->id];
+            }
+        }
+        if(!isMin && !isMax){ // mean
+            vals[id] = stats[id]/counts[id];
+        } else {
+            vals[id] = std::isinf(stats[id]) ? nan : stats[id];
+        }
+    }
+    return vals;
+}
+
+// calculates the value of every node for a matrix with the same dimensions as
+// the one used to create the quadtree. 'vals' must have 'nNodes' elements -
+// the value of each node is stored at the index given by its ID.
+void Quadtree::getLayerValues(const Matrix &mat, const std::shared_ptr<Node> node, std::function<double (const Matrix&)> combineFun, std::vector<double> &vals) const{
+    if(node->id < 0 || node->id >= static_cast<int>(vals.size())){
+        throw std::runtime_error("node IDs must be between 0 and the number of nodes minus one");
+    }
+    vals[node->id] = combineFun(mat);
+    if(node->hasChildren){
+        for(int r = 0; r < 2; ++r){
+            for(int c = 0; c < 2; ++c){
+                int c_beg = (mat.nCol()/2)*c;
+                int c_end = (c_beg + mat.nCol()/2)-1;
+                int r_beg = (mat.nRow()/2)*r;
+                int r_end = (r_beg + mat.nRow()/2)-1;
+                getLayerValues(mat.subset(r_beg,r_end,c_beg,c_end), node->children[(1-r)*2 + c], combineFun, vals);
+            }
+        }
+    }
+}
+
+// calculates the value of every node, indexed by node ID. The built-in combine
+// methods use 'getNodeValues()' - if 'combineMethod' is "custom",
+// 'combineFun' is used on the part of the matrix in every node. If 'nThreads'
+// is more than 1, the nodes are split between the threads, so 'combineFun'
+// must be safe to call from more than one thread (i.e. it can't be an R
+// function).
+std::vector<double> Quadtree::getLayerValues(const Matrix &mat, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads){
+    if(combineMethod != "custom"){
+        return getNodeValues(mat, combineMethod, nThreads);
+    }
+    if(mat.nCol() != matNX || mat.nRow() != matNY){
+        throw std::runtime_error("The dimensions of the matrix (" + std::to_string(mat.nRow()) + " rows, " + std::to_string(mat.nCol()) + " cols) must be identical to the dimensions of the matrix used to create the quadtree (" + std::to_string(matNY) + " rows, " + std::to_string(matNX) + " cols)");
+    }
+    std::vector<double> vals(nNodes);
+    if(nThreads <= 1){
+        getLayerValues(mat, root, combineFun, vals);
+        return vals;
+    }
+    std::vector<NodeRange> ranges = getNodeRanges();
+    parallel::forRange(ranges.size(), parallel::getNThreads(nThreads, ranges.size(), 64), [&](int begin, int end, int){
+        for(int i = begin; i < end; ++i){
+            const NodeRange &range = ranges[i];
+            vals[range.node->id] = combineFun(mat.subset(range.rMin, range.rMax, range.cMin, range.cMax));
+        }
+    });
+    return vals;
+}
+
+// same as 'getLayerValues()', but 'combineFun' is given the matrices of every
+// node at a level at once, and returns the value of each one - see
+// 'makeTreeByLevel()'
+std::vector<double> Quadtree::getLayerValuesByLevel(const Matrix &mat, const std::function<std::vector<double> (const std::vector<Matrix>&)> &combineFun){
+    if(mat.nCol() != matNX || mat.nRow() != matNY){
+        throw std::runtime_error("The dimensions of the matrix (" + std::to_string(mat.nRow()) + " rows, " + std::to_string(mat.nCol()) + " cols) must be identical to the dimensions of the matrix used to create the quadtree (" + std::to_string(matNY) + " rows, " + std::to_string(matNX) + " cols)");
+    }
+    std::vector<std::vector<NodeRange>> levels;
+    for(auto const &range : getNodeRanges()){
+        if(range.node->level < 0) throw std::runtime_error("node levels must not be negative");
+        if(range.node->level >= static_cast<int>(levels.size())) levels.resize(range.node->level + 1);
+        levels[range.node->level].push_back(range);
+    }
+    std::vector<double> vals(nNodes);
+    for(auto const &level : levels){
+        if(level.empty()) continue;
+        std::vector<Matrix> mats;
+        mats.reserve(level.size());
+        for(auto const &range : level){
+            mats.push_back(mat.subset(range.rMin, range.rMax, range.cMin, range.cMax));
+        }
+        std::vector<double> levelVals = combineFun(mats);
+        if(levelVals.size() != level.size()){
+            throw std::runtime_error("the combine function returned " + std::to_string(levelVals.size()) + " values for " + std::to_string(level.size()) + " cells");
+        }
+        for(size_t i = 0; i < level.size(); ++i){
+            vals[level[i].node->id] = levelVals[i];
+        }
+    }
+    return vals;
+}
+
+// ------- getNodeRanges -------
+// finds the rows and columns of the matrix used to create the quadtree that
+// are contained by every node (in the same way as 'makeTree()'), so that the
+// nodes can be processed in any order
+// RETURNS: one element per node, in depth-first order
+std::vector<Quadtree::NodeRange> Quadtree::getNodeRanges() const{
+    std::vector<NodeRange> ranges;
+    ranges.reserve(nNodes);
+    std::vector<NodeRange> stack{{root.get(), 0, matNY - 1, 0, matNX - 1}};
+    while(!stack.empty()){
+        NodeRange range = stack.back();
+        stack.pop_back();
+        if(range.node->id < 0 || range.node->id >= nNodes){
+            throw std::runtime_error("node IDs must be between 0 and the number of nodes minus one");
+        }
+        ranges.push_back(range);
+        if(range.node->hasChildren){
+            int halfRows = (range.rMax - range.rMin + 1)/2;
+            int halfCols = (range.cMax - range.cMin + 1)/2;
+            for(int r = 0; r < 2; ++r){
+                for(int c = 0; c < 2; ++c){
+                    int rBeg = range.rMin + halfRows*r;
+                    int cBeg = range.cMin + halfCols*c;
+                    stack.push_back({range.node->children[(1-r)*2 + c].get(), rBeg, rBeg + halfRows - 1, cBeg, cBeg + halfCols - 1});
+                }
+            }
+        }
+    }
+    return ranges;
+}
+
+// replaces the values of the quadtree with one layer per matrix. The first
+// layer becomes the active layer. If there's only one matrix the quadtree
+// goes back to having a single layer.
+void Quadtree::setLayers(const std::vector<Matrix> &mats, const std::vector<std::string> &names, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads){
+    if(mats.empty() || mats.size() != names.size()){
+        throw std::runtime_error("the number of names (" + std::to_string(names.size()) + ") must be the same as the number of layers (" + std::to_string(mats.size()) + "), and there must be at least one layer");
+    }
+    std::vector<std::vector<double>> vals;
+    for(auto const &mat : mats){
+        vals.push_back(getLayerValues(mat, combineMethod, combineFun, nThreads));
+    }
+    setLayers(vals, names);
+}
+
+// same as above, but with the values of each layer (indexed by node ID)
+// already calculated
+void Quadtree::setLayers(const std::vector<std::vector<double>> &vals, const std::vector<std::string> &names){
+    if(vals.empty() || vals.size() != names.size()){
+        throw std::runtime_error("the number of names (" + std::to_string(names.size()) + ") must be the same as the number of layers (" + std::to_string(vals.size()) + "), and there must be at least one layer");
+    }
+    std::vector<std::shared_ptr<ValueVector>> newLayers;
+    for(auto const &layerVals : vals){
+        if(static_cast<int>(layerVals.size()) != nNodes){
+            throw std::runtime_error("each layer must have one value per node");
+        }
+        newLayers.push_back(std::make_shared<ValueVector>(valueType, layerVals));
+    }
+    layers.clear();
+    layerNames.clear();
+    if(newLayers.size() > 1){
+        layers = newLayers;
+        layerNames = names;
+    }
+    activeLayer = 0;
+    setNodeValues(newLayers[0]->asDoubles());
+}
+
+// adds a layer calculated from a matrix with the same dimensions as the one
+// used to create the quadtree. If the quadtree only had one layer, its values
+// become the first layer, called "layer1". The active layer doesn't change.
+void Quadtree::addLayer(const Matrix &mat, const std::string &name, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads){
+    addLayer(getLayerValues(mat, combineMethod, combineFun, nThreads), name);
+}
+
+// same as above, but with the values of the layer (indexed by node ID)
+// already calculated
+void Quadtree::addLayer(const std::vector<double> &layerVals, const std::string &name){
+    if(static_cast<int>(layerVals.size()) != nNodes){
+        throw std::runtime_error("the layer must have one value per node");
+    }
+    auto vals = std::make_shared<ValueVector>(valueType, layerVals);
+    if(layers.empty()){
+        layers.push_back(std::make_shared<ValueVector>(valueType, getLayer(0)));
+        layerNames.push_back("layer1");
+        activeLayer = 0;
+    }
+    layers.push_back(vals);
+    layerNames.push_back(name);
+}
+
+// copies the values in the nodes into the active layer's vector
+void Quadtree::syncActiveLayer(){
+    if(layers.empty()) return;
+    layers[activeLayer] = std::make_shared<ValueVector>(valueType, getLayer(activeLayer));
+}
+
+// makes 'layer' the active layer by copying its values into the nodes
+void Quadtree::setActiveLayer(int layer){
+    if(layer < 0 || layer >= nLayers()){
+        throw std::runtime_error("invalid layer: " + std::to_string(layer) + " - the quadtree has " + std::to_string(nLayers()) + " layer(s)");
+    }
+    if(layer == activeLayer) return;
+    syncActiveLayer();
+    setNodeValues(layers[layer]->asDoubles());
+    activeLayer = layer;
+}
+
+// sets the value of every node from a vector indexed by node ID
+void Quadtree::setNodeValues(const std::vector<double> &vals){
+    detach();
+    std::vector<Node*> stack{root.get()};
+    while(!stack.empty()){
+        Node *node = stack.back();
+        stack.pop_back();
+        node->value = vals[node->id];
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                stack.push_back(child.get());
+            }
+        }
+    }
+}
+
+// changes the type used to store the values (see 'ValueVector'). The values
+// of every layer, including the values in the nodes, are converted to the new
+// type - for example, if the type is "int16" every value is rounded to the
+// nearest integer. Values that are changed afterwards (e.g. by 'setValues()')
+// are converted when they're stored in a layer.
+void Quadtree::setValueType(ValueVector::Type type){
+    valueType = type;
+    syncActiveLayer();
+    for(auto &layer : layers){
+        if(layer->getType() != type){
+            layer = std::make_shared<ValueVector>(type, layer->asDoubles());
+        }
+    }
+    if(type != ValueVector::Type::Double && nNodes > 0){
+        setNodeValues(ValueVector(type, getLayer(activeLayer)).asDoubles());
+    }
+}
+
+// returns the values of a layer, indexed by node ID
+std::vector<double> Quadtree::getLayer(int layer) const{
+    if(layer < 0 || layer >= nLayers()){
+        throw std::runtime_error("invalid layer: " + std::to_string(layer) + " - the quadtree has " + std::to_string(nLayers()) + " layer(s)");
+    }
+    if(layer != activeLayer){
+        return layers[layer]->asDoubles();
+    }
+    std::vector<double> vals(nNodes, std::numeric_limits<double>::quiet_NaN());
+    std::vector<Node*> stack{root.get()};
+    while(!stack.empty()){
+        Node *node = stack.back();
+        stack.pop_back();
+        if(node->id < 0 || node->id >= nNodes){
+            throw std::runtime_error("node IDs must be between 0 and the number of nodes minus one");
+        }
+        vals[node->id] = node->value;
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                stack.push_back(child.get());
+            }
+        }
+    }
+    return vals;
+}
+
+// returns the value of a node in one of the layers
+double Quadtree::getLayerValue(const Node &node, int layer) const{
+    if(layer == activeLayer){
+        return node.value;
+    }
+    if(layer < 0 || layer >= nLayers()){
+        throw std::runtime_error("invalid layer: " + std::to_string(layer) + " - the quadtree has " + std::to_string(nLayers()) + " layer(s)");
+    }
+    return layers[layer]->get(node.id);
+}
+
+// ------- copyNode -------
+// creates a deep copy of a node and its descendants. The neighbors aren't
+// copied - instead, each original node and its copy are added to 'copies' so
+// that the neighbors can be pointed at the copies afterwards (see
+// 'detach()').
+std::shared_ptr<Node> Quadtree::copyNode(const std::shared_ptr<Node> &nodeOrig, std::vector<std::pair<const Node*, std::shared_ptr<Node>>> &copies) const{
+    auto nodeCopy = std::make_shared<Node>(nodeOrig->xMin, nodeOrig->xMax, nodeOrig->yMin, nodeOrig->yMax, nodeOrig->value, nodeOrig->id, nodeOrig->level, nodeOrig->smallestChildSideLength, nodeOrig->hasChildren);
+    copies.emplace_back(nodeOrig.get(), nodeCopy);
+    if(nodeOrig->hasChildren){
+        for(size_t i = 0; i < nodeOrig->children.size(); ++i){
+            nodeCopy->children[i] = copyNode(nodeOrig->children[i], copies);
+        }
+    }
+    return nodeCopy;
+}
+
+// ------- detach -------
+// copies are copy-on-write - 'copy()' doesn't copy any nodes, so the copy and
+// the original share the same nodes. This must be called before anything
+// that changes the nodes (values, children, or neighbors). If the nodes are
+// shared, the quadtree gets its own copy of them. Otherwise (e.g. the
+// quadtree was never copied, it was already detached, or the other copies
+// have been deleted) this does nothing.
+// Since every node stores pointers to its neighbors, the whole tree has to be
+// copied at once - copying only part of it would leave the neighbors of the
+// nodes that weren't copied pointing at the nodes in the other quadtree. So
+// the first change to a shared quadtree takes time and memory proportional to
+// the number of nodes, not to the size of the change. The
+// neighbors are copied by looking up the copy of each neighbor by its ID
+// rather than calling 'assignNeighbors()', which is much slower. If the IDs
+// aren't unique (which shouldn't happen) 'assignNeighbors()' is used instead.
+void Quadtree::detach(){
+    if(!root || root.use_count() == 1) return;
+    std::vector<std::pair<const Node*, std::shared_ptr<Node>>> copies;
+    copies.reserve(nNodes);
+    std::shared_ptr<Node> rootCopy = copyNode(root, copies);
+    std::vector<int> index(copies.size(), -1); // Key: node ID. Value: index of the node in 'copies'
+    bool idsOk{true};
+    for(size_t i = 0; i < copies.size() && idsOk; ++i){
+        int id = copies[i].first->id;
+        idsOk = id >= 0 && id < static_cast<int>(index.size()) && index[id] == -1;
+        if(idsOk) index[id] = i;
+    }
+    root = rootCopy;
+    if(!idsOk){
+        assignNeighbors();
+        return;
+    }
+    for(auto const &pair : copies){
+        const Node *nodeOrig = pair.first;
+        Node &nodeCopy = *pair.second;
+        nodeCopy.neighbors.reserve(nodeOrig->neighbors.size());
+        for(auto const &nb : nodeOrig->neighbors){
+            nodeCopy.neighbors.push_back(copies[index[nb.lock()->id]].second);
+        }
+    }
 }
 
 // ------- copy -------
-// uses 'copy' to create a deep copy of a Quadtree object
+// creates a copy of a Quadtree object. This takes constant time, since the
+// copy shares its nodes with the original until one of them is modified (see
+// 'detach()').
 std::shared_ptr<Quadtree> Quadtree::copy() const{
-    std::shared_ptr<Quadtree> qtCopy = std::make_shared<Quadtree>(root->xMin, root->xMax, root->yMin, root->yMax, matNX, matNY, projection, maxXCellLength, maxYCellLength, minXCellLength, minYCellLength, splitAllNAs, splitAnyNAs);
-    
-    qtCopy->nNodes = nNodes;
-    copyNode(qtCopy->root, root);
-    qtCopy->assignNeighbors();
-    return(qtCopy);
+    return std::make_shared<Quadtree>(*this);
 }
 
 
@@ -478,11 +1554,13 @@ std::string Quadtree::toString() const{
 }
 
 // ------- writeQuadtree -------
-// writes a quadtree to a file
+// writes a quadtree to a file (see 'QuadtreeInfo::replaceFile()')
 void Quadtree::writeQuadtree(std::shared_ptr<Quadtree> quadtree, std::string filePath){
-    std::ofstream os(filePath, std::ios::binary);
-    cereal::PortableBinaryOutputArchive oarchive(os);
-    oarchive(quadtree);
+    QuadtreeInfo::replaceFile(filePath, [&](std::ostream &os){
+        cereal::PortableBinaryOutputArchive oarchive(os);
+        oarchive(quadtree);
+        quadtree->saveLayers(oarchive);
+    });
 }
 
 // ------- readQuadtree -------
@@ -493,6 +1571,7 @@ std::shared_ptr<Quadtree> Quadtree::readQuadtree(std::string filePath){
     Quadtree *quadtree = new Quadtree(-1,-1);
     std::shared_ptr<Quadtree> quadtreePtr(quadtree);
     iarchive(quadtreePtr);
+    quadtreePtr->loadLayers(iarchive, is);
     quadtreePtr->assignNeighbors(); // since we're not storing the neighbor relationships in the file we need to recalculate those.
     return(quadtreePtr);
 }
\ No newline at end of file
@@ -3,14 +3,17 @@
 
 #include "Matrix.h"
 #include "Node.h"
+#include "ValueVector.h"
 
 #include <cereal/archives/portable_binary.hpp>
 #include <cereal/types/memory.hpp>
 
 #include <functional>
+#include <istream>
 #include <list>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 class Quadtree
@@ -34,6 +37,41 @@ public:
     bool splitAnyNAs{true}; // should we split a quadrant if it contains any NAs?
 
     std::string projection{""}; // the projection string of the quadtree
+    std::string combineMethod{""}; // the method used to get the values of larger cells when the tree was created ("mean", "median", "min", "max", or "custom"). Empty if unknown. Not stored in files, since that would change the file format
+
+    // a quadtree can have more than one "layer" of values (e.g. one for each
+    // time step) that all share the same structure. The values of the
+    // "active" layer are stored in the nodes (so everything that uses
+    // 'Node::value' uses the active layer), and the values of every layer are
+    // stored in 'layers', indexed by node ID. Since the node values can be
+    // changed directly, the active layer's vector may be out of date - use
+    // 'syncActiveLayer()' to update it. Each vector is shared between copies
+    // of the quadtree until one of them changes it. The layers are stored
+    // using 'valueType', so they can take up less memory than the nodes.
+    std::vector<std::string> layerNames; // empty if the quadtree only has one layer
+    std::vector<std::shared_ptr<ValueVector>> layers; // empty if the quadtree only has one layer
+    int activeLayer{0};
+    ValueVector::Type valueType{ValueVector::Type::Double}; // see 'setValueType()'
+
+    // the leaves that each row of the matrix used to create the quadtree
+    // passes through, stored as runs of columns. This lets the values of every
+    // node be calculated in a single pass over a matrix (see
+    // 'getNodeValues()'). It's only created when it's needed, and since it
+    // only depends on the structure it's shared with copies and with
+    // quadtrees that use this one as a template.
+    struct PixelIndex{
+        std::vector<int> rowOffsets; // the runs in row 'i' are at [rowOffsets[i], rowOffsets[i + 1])
+        std::vector<int> colEnds; // one past the last column of each run - each run starts where the previous one ended
+        std::vector<int> leafIds; // the ID of the leaf that contains each run
+    };
+    std::shared_ptr<const PixelIndex> pixelIndex; // null until 'getPixelIndex()' is called
+
+    // the rows and columns of the matrix used to create the quadtree that a
+    // node contains - see 'getNodeRanges()'
+    struct NodeRange{
+        const Node *node;
+        int rMin, rMax, cMin, cMax;
+    };
 
     Quadtree(double xMin = 0, double xMax = 0, double yMin = 0, double yMax = 0, bool _splitAllNAs = false, bool _splitAnyNAs = true);
     Quadtree(double xMin, double xMax, double yMin, double yMax, double _maxXCellLength, double _maxYCellLength, double _minXCellLength, double _minYCellLength, bool _splitAllNAs, bool _splitAnyNAs);
@@ -42,30 +80,69 @@ public:
     static bool splitRange(const Matrix &mat, double limit);
     static bool splitSD(const Matrix &mat, double limit);
     static bool splitCV(const Matrix &mat, double limit);
+    static bool splitNClasses(const Matrix &mat, double limit);
+    static bool splitEntropy(const Matrix &mat, double limit);
+    static bool splitPurity(const Matrix &mat, double limit);
     static double combineMean(const Matrix &mat);
     static double combineMedian(const Matrix &mat);
     static double combineMin(const Matrix &mat);
     static double combineMax(const Matrix &mat);
+    static double combineMode(const Matrix &mat);
+    static std::function<double (const Matrix&)> getCombineFun(const std::string &method);
 
+    bool shouldSplit(const Matrix &mat, const std::shared_ptr<Node> node, std::function<bool (const Matrix&)> splitFun) const;
     int makeTree(const Matrix &mat, const std::shared_ptr<Node> node, int id, int level, std::function<bool (const Matrix&)> splitFun, std::function<double (const Matrix&)> combineFun);
     void makeTree(const Matrix &mat, std::function<bool (const Matrix&)> splitFun, std::function<double (const Matrix&)> combineFun);
     int makeTreeWithTemplate(const Matrix &mat, const std::shared_ptr<Node> node, const std::shared_ptr<Node> templateNode, std::function<double (const Matrix&)> combineFun);
     void makeTreeWithTemplate(const Matrix &mat, const std::shared_ptr<Quadtree> templateQuadtree, std::function<double (const Matrix&)> combineFun);
+    void makeTreeWithTemplate(const Matrix &mat, const std::shared_ptr<Quadtree> templateQuadtree, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads = 1);
+    void makeTreeWithTemplate(const Matrix &mat, const std::shared_ptr<Quadtree> templateQuadtree, const std::function<std::vector<double> (const std::vector<Matrix>&)> &combineFun);
+    void shareTemplate(const Matrix &mat, const std::shared_ptr<Quadtree> templateQuadtree);
+    int makeTree(const std::vector<Matrix> &mats, const std::shared_ptr<Node> node, int id, int level, const std::function<bool (const std::vector<Matrix>&)> &splitFun);
+    void makeTree(const std::vector<Matrix> &mats, const std::function<bool (const std::vector<Matrix>&)> &splitFun);
+    void makeTreeByLevel(const std::vector<Matrix> &mats, const std::function<std::vector<bool> (const std::vector<std::vector<Matrix>>&)> &splitFun, const std::function<std::vector<double> (const std::vector<Matrix>&)> &combineFun);
+    int restructure(const Matrix &mat, const std::vector<Point> &pts, std::function<bool (const Matrix&)> splitFun, std::function<double (const Matrix&)> combineFun);
+    void restructure(const Matrix &mat, const std::shared_ptr<Node> node, const std::vector<Point> &pts, std::function<bool (const Matrix&)> splitFun, std::function<double (const Matrix&)> combineFun, std::vector<std::shared_ptr<Node>> &changed);
+    int assignIds(const std::shared_ptr<Node> node, int id);
     std::vector<std::shared_ptr<Node> > findNeighbors(const std::shared_ptr<Node> node, double searchSideLength) const;
     void assignNeighbors(const std::shared_ptr<Node> node);
     void assignNeighbors();
 
     std::shared_ptr<Node> getNode(const Point pt, const std::shared_ptr<Node> node) const;
     std::shared_ptr<Node> getNode(const Point pt) const;
+    std::shared_ptr<Node> getNode(const int id, const std::shared_ptr<Node> node) const;
+    std::shared_ptr<Node> getNode(const int id) const;
     double getValue(const Point pt) const;
     void getNodesInBox(std::shared_ptr<Node> node, std::list<std::shared_ptr<Node>> &returnNodes, double xMin, double xMax, double yMin, double yMax, bool byCentroid);
     std::list<std::shared_ptr<Node>> getNodesInBox(double xMin, double xMax, double yMin, double yMax, bool byCentroid = false);
 
     void setValue(const Point pt, double newValue);
+    void setValues(const std::vector<Point> &pts, const std::vector<double> &newValues, std::function<double (const Matrix&)> combineFun = nullptr);
+    void updateAncestors(std::vector<std::shared_ptr<Node>> &nodes, std::function<double (const Matrix&)> combineFun);
     void transformValues(std::shared_ptr<Node> node, std::function<double (const double)> &transformFun);
     void transformValues(std::function<double (const double)> &transformFun);
-
-    int copyNode(std::shared_ptr<Node> nodeCopy, const std::shared_ptr<Node> nodeOrig) const;
+    void transformValuesVector(const std::function<void (std::vector<double>&)> &transformFun);
+
+    int nLayers() const;
+    std::shared_ptr<const PixelIndex> getPixelIndex();
+    std::vector<double> getNodeValues(const Matrix &mat, const std::string &combineMethod, int nThreads = 1);
+    void getLayerValues(const Matrix &mat, const std::shared_ptr<Node> node, std::function<double (const Matrix&)> combineFun, std::vector<double> &vals) const;
+    std::vector<double> getLayerValues(const Matrix &mat, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads = 1);
+    std::vector<double> getLayerValuesByLevel(const Matrix &mat, const std::function<std::vector<double> (const std::vector<Matrix>&)> &combineFun);
+    std::vector<NodeRange> getNodeRanges() const;
+    void setLayers(const std::vector<Matrix> &mats, const std::vector<std::string> &names, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads = 1);
+    void setLayers(const std::vector<std::vector<double>> &vals, const std::vector<std::string> &names);
+    void addLayer(const Matrix &mat, const std::string &name, const std::string &combineMethod, std::function<double (const Matrix&)> combineFun, int nThreads = 1);
+    void addLayer(const std::vector<double> &layerVals, const std::string &name);
+    void syncActiveLayer();
+    void setActiveLayer(int layer);
+    void setNodeValues(const std::vector<double> &vals);
+    void setValueType(ValueVector::Type type);
+    std::vector<double> getLayer(int layer) const;
+    double getLayerValue(const Node &node, int layer) const;
+
+    std::shared_ptr<Node> copyNode(const std::shared_ptr<Node> &nodeOrig, std::vector<std::pair<const Node*, std::shared_ptr<Node>>> &copies) const;
+    void detach();
     std::shared_ptr<Quadtree> copy() const;
 
     int toVector(std::shared_ptr<Node> node, std::vector<double> &vals, int i, bool terminalOnly) const;
@@ -79,6 +156,32 @@ public:
         archive(root, nNodes, matNX, matNY, maxXCellLength, maxYCellLength, minXCellLength, minYCellLength, splitAllNAs, splitAnyNAs, projection);
     }
 
+    // the layers and value type are written after the rest of the quadtree
+    // (and only if there's more than one layer or the value type isn't
+    // "double") so that other files don't change
+    template<class Archive>
+    void saveLayers(Archive & archive){
+        if(layers.empty() && valueType == ValueVector::Type::Double) return;
+        syncActiveLayer();
+        std::vector<ValueVector> vals;
+        for(auto const &layer : layers){
+            vals.push_back(*layer);
+        }
+        archive(layerNames, vals, activeLayer, static_cast<int>(valueType));
+    }
+    template<class Archive>
+    void loadLayers(Archive & archive, std::istream &is){
+        if(is.peek() == std::char_traits<char>::eof()) return;
+        std::vector<ValueVector> vals;
+        int valueTypeInt{0};
+        archive(layerNames, vals, activeLayer, valueTypeInt);
+        valueType = static_cast<ValueVector::Type>(valueTypeInt);
+        layers.clear();
+        for(auto &layer : vals){
+            layers.push_back(std::make_shared<ValueVector>(std::move(layer)));
+        }
+    }
+
     static void writeQuadtree(std::shared_ptr<Quadtree> quadtree, std::string filePath);
     static std::shared_ptr<Quadtree> readQuadtree(std::string filePath);
 };
@@ -0,0 +1,385 @@
+#include "QuadtreeInfo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <streambuf>
+
+const char QuadtreeInfo::MAGIC[8] = {'Q', 'T', 'I', 'N', 'F', 'O', '\0', '\0'};
+const uint32_t QuadtreeInfo::VERSION = 1;
+
+namespace {
+    const size_t FIXED_SIZE = 24; // magic, version, format, and header size
+    const uint64_t MAX_HEADER_SIZE = 1 << 30;
+
+    std::runtime_error invalidHeader(const std::string &filePath, const std::string &reason){
+        return std::runtime_error("'" + filePath + "' doesn't have a valid quadtree header: " + reason);
+    }
+
+    // ------- little-endian numbers -------
+    void putUInt(std::string &bytes, uint64_t val, int nBytes){
+        for(int i = 0; i < nBytes; ++i){
+            bytes.push_back(static_cast<char>((val >> (8 * i)) & 0xFF));
+        }
+    }
+
+    void putDouble(std::string &bytes, double val){
+        uint64_t bits;
+        std::memcpy(&bits, &val, sizeof(double));
+        putUInt(bytes, bits, 8);
+    }
+
+    void putString(std::string &bytes, const std::string &str){
+        putUInt(bytes, str.size(), 8);
+        bytes += str;
+    }
+
+    // reads numbers and strings from the bytes of a header
+    class Reader{
+        const std::string &bytes;
+        const std::string &filePath;
+        size_t pos{0};
+
+    public:
+        Reader(const std::string &_bytes, const std::string &_filePath) : bytes{_bytes}, filePath{_filePath} {}
+
+        size_t position() const{
+            return pos;
+        }
+
+        uint64_t getUInt(int nBytes){
+            if(bytes.size() - pos < static_cast<size_t>(nBytes)) throw invalidHeader(filePath, "the header is truncated");
+            uint64_t val{0};
+            for(int i = 0; i < nBytes; ++i){
+                val |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[pos++])) << (8 * i);
+            }
+            return val;
+        }
+
+        double getDouble(){
+            uint64_t bits = getUInt(8);
+            double val;
+            std::memcpy(&val, &bits, sizeof(double));
+            return val;
+        }
+
+        std::string getString(){
+            uint64_t length = getUInt(8);
+            if(length > bytes.size() - pos) throw invalidHeader(filePath, "the header is truncated");
+            std::string str = bytes.substr(pos, length);
+            pos += length;
+            return str;
+        }
+    };
+
+    // stream buffer that passes everything on to another stream buffer while
+    // keeping track of the number of bytes and their checksum
+    class ChecksumBuffer : public std::streambuf{
+        std::streambuf *dest;
+
+    public:
+        uint64_t size{0};
+        uint32_t checksum{0};
+
+        ChecksumBuffer(std::streambuf *_dest) : dest{_dest} {}
+
+    protected:
+        int_type overflow(int_type ch) override{
+            if(traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+            char c = traits_type::to_char_type(ch);
+            return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize n) override{
+            std::streamsize written = dest->sputn(s, n);
+            checksum = QuadtreeInfo::crc32(s, written, checksum);
+            size += written;
+            return written;
+        }
+    };
+}
+
+// ------- fromQuadtree -------
+// summarizes a quadtree. The value statistics only use the leaves.
+QuadtreeInfo QuadtreeInfo::fromQuadtree(Quadtree &quadtree, const std::vector<double> &original, Format format){
+    quadtree.syncActiveLayer();
+    QuadtreeInfo info;
+    info.version = VERSION;
+    info.format = format;
+    info.valueType = quadtree.valueType;
+    info.nNodes = quadtree.nNodes;
+    info.nLayers = quadtree.layers.size();
+    info.activeLayer = quadtree.activeLayer;
+    info.xMin = quadtree.root->xMin;
+    info.xMax = quadtree.root->xMax;
+    info.yMin = quadtree.root->yMin;
+    info.yMax = quadtree.root->yMax;
+    info.original = original.size() == 6 ? original : std::vector<double>(6, std::numeric_limits<double>::quiet_NaN());
+    info.minXCellLength = info.minYCellLength = std::numeric_limits<double>::infinity();
+    info.maxXCellLength = info.maxYCellLength = 0;
+    info.projection = quadtree.projection;
+
+    int nVals = std::max(info.nLayers, 1);
+    std::vector<std::vector<double>> layerVals;
+    for(int i = 0; i < info.nLayers; ++i){
+        layerVals.push_back(quadtree.getLayer(i));
+    }
+    std::vector<double> sums(nVals, 0);
+    info.layers.resize(nVals);
+    for(int i = 0; i < nVals; ++i){
+        info.layers[i].name = i < static_cast<int>(quadtree.layerNames.size()) ? quadtree.layerNames[i] : "";
+        info.layers[i].min = std::numeric_limits<double>::infinity();
+        info.layers[i].max = -std::numeric_limits<double>::infinity();
+    }
+    std::vector<const Node*> stack{quadtree.root.get()};
+    while(!stack.empty()){
+        const Node *node = stack.back();
+        stack.pop_back();
+        if(node->hasChildren){
+            for(auto const &child : node->children){
+                stack.push_back(child.get());
+            }
+            continue;
+        }
+        ++info.nLeaves;
+        info.minXCellLength = std::min(info.minXCellLength, node->xMax - node->xMin);
+        info.minYCellLength = std::min(info.minYCellLength, node->yMax - node->yMin);
+        info.maxXCellLength = std::max(info.maxXCellLength, node->xMax - node->xMin);
+        info.maxYCellLength = std::max(info.maxYCellLength, node->yMax - node->yMin);
+        for(int i = 0; i < nVals; ++i){
+            double val = layerVals.empty() ? node->value : layerVals[i].at(node->id);
+            LayerStats &stats = info.layers[i];
+            if(std::isnan(val)){
+                ++stats.nNA;
+            } else {
+                stats.min = std::min(stats.min, val);
+                stats.max = std::max(stats.max, val);
+                sums[i] += val;
+            }
+        }
+    }
+    for(int i = 0; i < nVals; ++i){
+        LayerStats &stats = info.layers[i];
+        if(stats.nNA == info.nLeaves){
+            stats.min = stats.max = stats.mean = std::numeric_limits<double>::quiet_NaN();
+        } else {
+            stats.mean = sums[i] / (info.nLeaves - stats.nNA);
+        }
+    }
+    return info;
+}
+
+// ------- hasInfo -------
+// checks whether a file starts with the magic bytes of the header
+bool QuadtreeInfo::hasInfo(const std::string &filePath){
+    std::ifstream is(filePath, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if(!is.read(magic, sizeof(MAGIC))) return false;
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// ------- read -------
+// reads the header of a file - nothing after the header is read
+QuadtreeInfo QuadtreeInfo::read(const std::string &filePath){
+    std::ifstream is(filePath, std::ios::binary | std::ios::ate);
+    if(!is) throw std::runtime_error("unable to open '" + filePath + "'");
+    uint64_t fileSize = is.tellg();
+    is.seekg(0);
+    std::string bytes(FIXED_SIZE, '\0');
+    if(!is.read(&bytes[0], FIXED_SIZE) || std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0){
+        throw invalidHeader(filePath, "the file doesn't start with the expected bytes");
+    }
+    Reader reader(bytes, filePath);
+    reader.getUInt(sizeof(MAGIC));
+    QuadtreeInfo info;
+    info.version = reader.getUInt(4);
+    if(info.version != VERSION) throw invalidHeader(filePath, "unsupported version (" + std::to_string(info.version) + ")");
+    uint32_t format = reader.getUInt(4);
+    if(format > static_cast<uint32_t>(Format::Compact)) throw invalidHeader(filePath, "unrecognized format");
+    info.format = static_cast<Format>(format);
+    info.headerSize = reader.getUInt(8);
+    if(info.headerSize < FIXED_SIZE || info.headerSize % 8 != 0 || info.headerSize > MAX_HEADER_SIZE || info.headerSize > fileSize) throw invalidHeader(filePath, "invalid header size");
+    bytes.resize(info.headerSize);
+    if(!is.read(&bytes[FIXED_SIZE], info.headerSize - FIXED_SIZE)) throw invalidHeader(filePath, "the header is truncated");
+
+    info.dataSize = reader.getUInt(8);
+    info.dataChecksum = reader.getUInt(4);
+    uint32_t valueType = reader.getUInt(4);
+    if(valueType > static_cast<uint32_t>(ValueVector::Type::UInt8)) throw invalidHeader(filePath, "invalid value type");
+    info.valueType = static_cast<ValueVector::Type>(valueType);
+    info.nNodes = reader.getUInt(8);
+    info.nLeaves = reader.getUInt(8);
+    info.nLayers = reader.getUInt(4);
+    info.activeLayer = reader.getUInt(4);
+    if(info.nLayers < 0 || info.nLayers > std::numeric_limits<int32_t>::max() - 1) throw invalidHeader(filePath, "invalid number of layers");
+    info.xMin = reader.getDouble();
+    info.xMax = reader.getDouble();
+    info.yMin = reader.getDouble();
+    info.yMax = reader.getDouble();
+    for(int i = 0; i < 6; ++i){
+        info.original.push_back(reader.getDouble());
+    }
+    info.minXCellLength = reader.getDouble();
+    info.minYCellLength = reader.getDouble();
+    info.maxXCellLength = reader.getDouble();
+    info.maxYCellLength = reader.getDouble();
+    info.projection = reader.getString();
+    for(int i = 0; i < std::max(info.nLayers, 1); ++i){
+        LayerStats stats;
+        stats.name = reader.getString();
+        stats.nNA = reader.getUInt(8);
+        stats.min = reader.getDouble();
+        stats.max = reader.getDouble();
+        stats.mean = reader.getDouble();
+        info.layers.push_back(stats);
+    }
+    size_t checksumPos = reader.position();
+    uint32_t checksum = reader.getUInt(4);
+    if(checksum != crc32(bytes.data(), checksumPos)) throw invalidHeader(filePath, "the checksum doesn't match - the header is corrupted");
+    if(info.headerSize + info.dataSize != fileSize) throw invalidHeader(filePath, "the size of the file doesn't match the header - the file is truncated or corrupted");
+    return info;
+}
+
+// ------- writeFile -------
+// writes a file that starts with the header. 'writeData' writes the rest of
+// the file - the data size and checksum are calculated while it's written,
+// and the header is then rewritten with them. The file is written with
+// 'replaceFile()'.
+void QuadtreeInfo::writeFile(const std::string &filePath, QuadtreeInfo info, const std::function<void (std::ostream&)> &writeData){
+    replaceFile(filePath, [&](std::ostream &os){
+        std::string header = info.toBytes();
+        os.write(header.data(), header.size());
+
+        ChecksumBuffer buffer(os.rdbuf());
+        std::ostream dataStream(&buffer);
+        writeData(dataStream);
+        if(!dataStream || !os) throw std::runtime_error("unable to write to '" + filePath + "'");
+
+        info.dataSize = buffer.size;
+        info.dataChecksum = buffer.checksum;
+        std::string finalHeader = info.toBytes(); // the size doesn't depend on the data size or checksum
+        os.seekp(0);
+        os.write(finalHeader.data(), finalHeader.size());
+    });
+}
+
+// ------- replaceFile -------
+// writes a file by writing it to a temporary file in the same directory and
+// then renaming it, so an existing file is replaced all at once rather than
+// being truncated and rewritten. Files opened with 'map_quadtree()' are
+// mapped into memory, and truncating a file while it's mapped makes the next
+// access to the mapping crash the process - if the file is renamed over
+// instead, the mapping keeps the old file until it's closed.
+void QuadtreeInfo::replaceFile(const std::string &filePath, const std::function<void (std::ostream&)> &write){
+    std::string tempPath = filePath + ".tmp" + std::to_string(std::random_device()());
+    try{
+        {
+            std::ofstream os(tempPath, std::ios::binary);
+            if(!os) throw std::runtime_error("unable to open '" + filePath + "' for writing");
+            write(os);
+            os.close();
+            if(!os) throw std::runtime_error("unable to write to '" + filePath + "'");
+        }
+#ifdef _WIN32
+        std::remove(filePath.c_str()); // 'rename()' doesn't replace existing files on Windows
+#endif
+        if(std::rename(tempPath.c_str(), filePath.c_str()) != 0) throw std::runtime_error("unable to write to '" + filePath + "'");
+    } catch(...){
+        std::remove(tempPath.c_str());
+        throw;
+    }
+}
+
+// ------- checkData -------
+// checks whether the rest of the file matches the data checksum. The whole
+// file is read, but the quadtree isn't.
+bool QuadtreeInfo::checkData(const std::string &filePath) const{
+    std::ifstream is(filePath, std::ios::binary);
+    if(!is) throw std::runtime_error("unable to open '" + filePath + "'");
+    is.seekg(headerSize);
+    std::vector<char> buffer(1 << 16);
+    uint32_t checksum{0};
+    uint64_t size{0};
+    while(is){
+        is.read(buffer.data(), buffer.size());
+        checksum = crc32(buffer.data(), is.gcount(), checksum);
+        size += is.gcount();
+    }
+    return size == dataSize && checksum == dataChecksum;
+}
+
+// ------- toBytes -------
+// returns the bytes of the header, including the header checksum and the
+// padding at the end
+std::string QuadtreeInfo::toBytes() const{
+    std::string bytes(MAGIC, sizeof(MAGIC));
+    putUInt(bytes, VERSION, 4);
+    putUInt(bytes, static_cast<uint32_t>(format), 4);
+    putUInt(bytes, 0, 8); // header size - filled in below
+    putUInt(bytes, dataSize, 8);
+    putUInt(bytes, dataChecksum, 4);
+    putUInt(bytes, static_cast<uint32_t>(valueType), 4);
+    putUInt(bytes, nNodes, 8);
+    putUInt(bytes, nLeaves, 8);
+    putUInt(bytes, nLayers, 4);
+    putUInt(bytes, activeLayer, 4);
+    for(double val : {xMin, xMax, yMin, yMax}){
+        putDouble(bytes, val);
+    }
+    for(int i = 0; i < 6; ++i){
+        putDouble(bytes, original.size() == 6 ? original[i] : std::numeric_limits<double>::quiet_NaN());
+    }
+    for(double val : {minXCellLength, minYCellLength, maxXCellLength, maxYCellLength}){
+        putDouble(bytes, val);
+    }
+    putString(bytes, projection);
+    for(auto const &stats : layers){
+        putString(bytes, stats.name);
+        putUInt(bytes, stats.nNA, 8);
+        putDouble(bytes, stats.min);
+        putDouble(bytes, stats.max);
+        putDouble(bytes, stats.mean);
+    }
+    uint64_t size = (bytes.size() + 4 + 7) / 8 * 8;
+    std::string sizeBytes;
+    putUInt(sizeBytes, size, 8);
+    bytes.replace(16, 8, sizeBytes);
+    putUInt(bytes, crc32(bytes.data(), bytes.size()), 4);
+    bytes.resize(size, '\0');
+    return bytes;
+}
+
+// ------- crc32 -------
+// CRC-32 (the one used by zip and PNG). 'crc' is the checksum of the bytes
+// before these ones, which lets the checksum be calculated in pieces.
+uint32_t QuadtreeInfo::crc32(const char *bytes, size_t n, uint32_t crc){
+    static const std::vector<uint32_t> table = []{
+        std::vector<uint32_t> t(256);
+        for(uint32_t i = 0; i < 256; ++i){
+            uint32_t c = i;
+            for(int j = 0; j < 8; ++j){
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for(size_t i = 0; i < n; ++i){
+        crc = table[(crc ^ static_cast<unsigned char>(bytes[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+std::string QuadtreeInfo::formatToString(Format format){
+    switch(format){
+        case Format::Flat: return "flat";
+        case Format::Compact: return "compact";
+        default: return "cereal";
+    }
+}
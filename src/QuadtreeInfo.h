@@ -0,0 +1,76 @@
+#ifndef QUADTREEINFO_H
+#define QUADTREEINFO_H
+
+#include "Quadtree.h"
+#include "ValueVector.h"
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// summary of a quadtree that's written at the start of every quadtree file,
+// regardless of the format. It contains everything needed to list or check a
+// file without reading the quadtree itself. The header is laid out as
+// follows (all numbers are little-endian, so it can be read on any machine):
+//
+//   magic (8 bytes), version (uint32), format (uint32)
+//   header size (uint64) - the data written by the format starts here
+//   data size (uint64), data checksum (uint32), value type (uint32)
+//   number of nodes (int64), number of leaves (int64)
+//   number of layers (int32, 0 if there's only one), active layer (int32)
+//   extent of the root (4 doubles), original extent and dimensions (6 doubles)
+//   smallest and largest leaf side lengths (x, then y) (4 doubles)
+//   projection (uint64 length followed by the characters)
+//   for each layer: name (as above), number of NA leaves (int64), min, max,
+//      and mean of the non-NA leaf values (3 doubles)
+//   header checksum (uint32)
+//   zeros, up to a multiple of 8 bytes
+//
+// The checksums are CRC-32s - the header checksum covers everything before
+// it, and the data checksum covers everything after the header.
+class QuadtreeInfo{
+public:
+    enum class Format {Cereal, Flat, Compact};
+
+    struct LayerStats{
+        std::string name;
+        int64_t nNA{0};
+        double min{0}, max{0}, mean{0};
+    };
+
+    uint32_t version{0}; // 0 if the file doesn't have a header (i.e. it was written before headers were added)
+    Format format{Format::Cereal};
+    uint64_t headerSize{0};
+    uint64_t dataSize{0};
+    uint32_t dataChecksum{0};
+    ValueVector::Type valueType{ValueVector::Type::Double};
+    int64_t nNodes{0};
+    int64_t nLeaves{0};
+    int32_t nLayers{0}; // 0 if the quadtree only has one layer
+    int32_t activeLayer{0};
+    double xMin{0}, xMax{0}, yMin{0}, yMax{0};
+    std::vector<double> original; // original extent and dimensions (xMin, xMax, yMin, yMax, nX, nY)
+    double minXCellLength{0}, minYCellLength{0}, maxXCellLength{0}, maxYCellLength{0};
+    std::string projection;
+    std::vector<LayerStats> layers; // one per layer - always has at least one element
+
+    static const char MAGIC[8];
+    static const uint32_t VERSION;
+
+    static QuadtreeInfo fromQuadtree(Quadtree &quadtree, const std::vector<double> &original, Format format);
+    static bool hasInfo(const std::string &filePath);
+    static QuadtreeInfo read(const std::string &filePath);
+    static void writeFile(const std::string &filePath, QuadtreeInfo info, const std::function<void (std::ostream&)> &writeData);
+    static void replaceFile(const std::string &filePath, const std::function<void (std::ostream&)> &write);
+
+    bool checkData(const std::string &filePath) const;
+    std::string toBytes() const;
+
+    static uint32_t crc32(const char *bytes, size_t n, uint32_t crc = 0);
+    static std::string formatToString(Format format);
+};
+
+#endif
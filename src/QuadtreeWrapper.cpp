@@ -1,14 +1,25 @@
 #include "QuadtreeWrapper.h"
 
+#include "CircuitSolver.h"
+#include "CompactQuadtree.h"
+#include "LeafGraph.h"
+#include "MappedQuadtreeWrapper.h"
 #include "Matrix.h"
+#include "Parallel.h"
 #include "Point.h"
+#include "QuadtreeInfo.h"
 #include "R_Interface.h"
+#include "RandomWalker.h"
+#include "TransformKernels.h"
+#include "quadtree_plugins.h"
 
 #include <algorithm>
 //#include <cassert>
 #include <cmath>
 #include <functional>
 #include <fstream>
+#include <limits>
+#include <random>
 
 QuadtreeWrapper::QuadtreeWrapper() : quadtree{nullptr} {}
 
@@ -80,58 +91,331 @@ std::string QuadtreeWrapper::getProjection() const{
   return quadtree->projection;
 }
 
-void QuadtreeWrapper::createTree(Rcpp::NumericMatrix &mat, std::string splitMethod, double splitThreshold, std::string combineMethod, Rcpp::Function splitFun, Rcpp::List splitArgs, Rcpp::Function combineFun, Rcpp::List combineArgs, QuadtreeWrapper templateQuadtree){
-  Matrix matNew(rInterface::rMatToCppMat(mat));
-  
-  // set the combine function
-  std::function<double (const Matrix&)> combine = [](const Matrix &mat) -> double {
-    return Quadtree::combineMean(mat);
-  };
-  if(combineMethod != "custom"){
-    if(combineMethod == "median"){
-      combine = [](const Matrix &mat) -> double {
-        return Quadtree::combineMedian(mat);
-      };   
-    } else if(combineMethod == "min"){
-      combine = [](const Matrix &mat) -> double {
-        return Quadtree::combineMin(mat);
-      };
-    } else if(combineMethod == "max"){
-      combine = [](const Matrix &mat) -> double {
-        return Quadtree::combineMax(mat);
-      };
+namespace {
+  // a custom split or combine function is either an R function or an external
+  // pointer to a compiled function (see 'quadtree_plugins.h')
+  bool isPlugin(SEXP fun){
+    return TYPEOF(fun) == EXTPTRSXP;
+  }
+
+  // gets the function pointer stored in an external pointer. The tag is checked
+  // first, since calling anything other than a function of the expected type
+  // would crash R
+  template<typename T>
+  T getPlugin(SEXP fun, const std::string &tag, const std::string &paramName){
+    SEXP ptrTag = R_ExternalPtrTag(fun);
+    if(TYPEOF(ptrTag) != STRSXP || Rf_length(ptrTag) != 1 || tag != CHAR(STRING_ELT(ptrTag, 0))){
+      throw std::runtime_error("the external pointer given as '" + paramName + "' isn't a '" + tag + "' (see 'quadtree_plugins.h')");
     }
+    Rcpp::XPtr<T> ptr(fun);
+    if(!ptr.get() || !*ptr){
+      throw std::runtime_error("the external pointer given as a custom function is NULL");
+    }
+    return *ptr;
+  }
+
+  // compiled functions are given the arguments as a single numeric vector, so
+  // they don't need to use the R API
+  std::vector<double> getPluginArgs(Rcpp::List args){
+    std::vector<double> vals;
+    for(int i = 0; i < args.size(); ++i){
+      std::vector<double> arg = Rcpp::as<std::vector<double>>(args[i]);
+      vals.insert(vals.end(), arg.begin(), arg.end());
+    }
+    return vals;
+  }
+}
+
+// returns the split function for 'splitMethod' ("range", "sd", "cv",
+// "n_classes", "entropy", "purity", or "custom" - in which case 'splitFun' is
+// used, which is either an R function or a compiled function)
+std::function<bool (const Matrix&)> QuadtreeWrapper::makeSplitFun(std::string splitMethod, double splitThreshold, SEXP splitFun, Rcpp::List splitArgs){
+  if(splitMethod == "custom" && isPlugin(splitFun)){
+    quadtree_split_fun fun = getPlugin<quadtree_split_fun>(splitFun, QUADTREE_SPLIT_FUN_TAG, "split_fun");
+    std::vector<double> args = getPluginArgs(splitArgs);
+    return [fun, args] (const Matrix &mat) -> bool{
+      return fun(mat.vec.data(), mat.vec.size(), args.data(), args.size());
+    };
+  } else if(splitMethod == "custom"){
+    Rcpp::Function rFun(splitFun);
+    return [splitArgs, rFun] (const Matrix &mat) -> bool{
+      return Rcpp::as<bool>(rFun(mat.vec, splitArgs));
+    };
+  } else if(splitMethod == "sd"){
+    return [splitThreshold](const Matrix &mat) -> bool {
+      return Quadtree::splitSD(mat, splitThreshold);
+    };
+  } else if(splitMethod == "cv"){
+    return [splitThreshold](const Matrix &mat) -> bool {
+      return Quadtree::splitCV(mat, splitThreshold);
+    };
+  } else if(splitMethod == "n_classes"){
+    return [splitThreshold](const Matrix &mat) -> bool {
+      return Quadtree::splitNClasses(mat, splitThreshold);
+    };
+  } else if(splitMethod == "entropy"){
+    return [splitThreshold](const Matrix &mat) -> bool {
+      return Quadtree::splitEntropy(mat, splitThreshold);
+    };
+  } else if(splitMethod == "purity"){
+    return [splitThreshold](const Matrix &mat) -> bool {
+      return Quadtree::splitPurity(mat, splitThreshold);
+    };
+  }
+  return [splitThreshold](const Matrix &mat) -> bool {
+    return Quadtree::splitRange(mat, splitThreshold);
+  };
+}
+
+// returns the combine function for 'combineMethod' ("mean", "median", "min",
+// "max", "mode", or "custom" - in which case 'combineFun' is used, which is
+// either an R function or a compiled function)
+std::function<double (const Matrix&)> QuadtreeWrapper::makeCombineFun(std::string combineMethod, SEXP combineFun, Rcpp::List combineArgs){
+  if(combineMethod == "custom" && isPlugin(combineFun)){
+    quadtree_combine_fun fun = getPlugin<quadtree_combine_fun>(combineFun, QUADTREE_COMBINE_FUN_TAG, "combine_fun");
+    std::vector<double> args = getPluginArgs(combineArgs);
+    return [fun, args] (const Matrix &mat) -> double{
+      return fun(mat.vec.data(), mat.vec.size(), args.data(), args.size());
+    };
+  } else if(combineMethod == "custom"){
+    Rcpp::Function rFun(combineFun);
+    return [combineArgs, rFun] (const Matrix &mat) -> double{
+      return Rcpp::as<double>(rFun(mat.vec, combineArgs));
+    };
+  } else if(combineMethod == "median" || combineMethod == "min" || combineMethod == "max" || combineMethod == "mode"){
+    return Quadtree::getCombineFun(combineMethod);
+  }
+  return Quadtree::combineMean;
+}
+
+// returns a split function that's given every quadrant at a level at once
+// (see 'Quadtree::makeTreeByLevel()'). If 'splitFun' is an R function, it's
+// called once with a list of the values in each quadrant (a matrix with one
+// column per layer if 'layered' is true) and must return a logical vector
+// with one element per quadrant - otherwise the function from
+// 'makeSplitFun()' (or 'makeLayeredSplitFun()') is called on each quadrant.
+std::function<std::vector<bool> (const std::vector<std::vector<Matrix>>&)> QuadtreeWrapper::makeVectorizedSplitFun(std::string splitMethod, double splitThreshold, SEXP splitFun, Rcpp::List splitArgs, bool layered){
+  if(splitMethod == "custom" && !isPlugin(splitFun)){
+    Rcpp::Function rFun(splitFun);
+    return [splitArgs, rFun, layered] (const std::vector<std::vector<Matrix>> &mats) -> std::vector<bool>{
+      Rcpp::List vals(mats.size());
+      for(size_t i = 0; i < mats.size(); ++i){
+        if(layered){
+          Rcpp::NumericMatrix layerVals(mats[i][0].size(), mats[i].size());
+          for(size_t j = 0; j < mats[i].size(); ++j){
+            std::copy(mats[i][j].vec.begin(), mats[i][j].vec.end(), layerVals.begin() + j * mats[i][0].size());
+          }
+          vals[i] = layerVals;
+        } else {
+          vals[i] = Rcpp::NumericVector(mats[i][0].vec.begin(), mats[i][0].vec.end());
+        }
+      }
+      Rcpp::LogicalVector result(rFun(vals, splitArgs));
+      std::vector<bool> split(result.size());
+      for(int i = 0; i < result.size(); ++i){
+        if(result[i] == NA_LOGICAL){
+          throw std::runtime_error("the split function returned NA");
+        }
+        split[i] = result[i];
+      }
+      return split;
+    };
+  }
+  std::function<bool (const std::vector<Matrix>&)> fun;
+  if(layered){
+    fun = makeLayeredSplitFun(splitMethod, splitThreshold, splitFun, splitArgs);
   } else {
-    combine = [&combineArgs, &combineFun] (const Matrix &mat) -> double{
-      return Rcpp::as<double>(combineFun(mat.vec, combineArgs));
+    std::function<bool (const Matrix&)> matFun = makeSplitFun(splitMethod, splitThreshold, splitFun, splitArgs);
+    fun = [matFun](const std::vector<Matrix> &mats) -> bool { return matFun(mats[0]); };
+  }
+  return [fun](const std::vector<std::vector<Matrix>> &mats) -> std::vector<bool>{
+    std::vector<bool> split(mats.size());
+    for(size_t i = 0; i < mats.size(); ++i){
+      split[i] = fun(mats[i]);
+    }
+    return split;
+  };
+}
+
+// same as 'makeVectorizedSplitFun()', but for combine functions - an R
+// function is called once with a list of the values in each cell, and must
+// return a numeric vector with one element per cell
+std::function<std::vector<double> (const std::vector<Matrix>&)> QuadtreeWrapper::makeVectorizedCombineFun(std::string combineMethod, SEXP combineFun, Rcpp::List combineArgs){
+  if(combineMethod == "custom" && !isPlugin(combineFun)){
+    Rcpp::Function rFun(combineFun);
+    return [combineArgs, rFun] (const std::vector<Matrix> &mats) -> std::vector<double>{
+      Rcpp::List vals(mats.size());
+      for(size_t i = 0; i < mats.size(); ++i){
+        vals[i] = Rcpp::NumericVector(mats[i].vec.begin(), mats[i].vec.end());
+      }
+      Rcpp::NumericVector result(rFun(vals, combineArgs));
+      return std::vector<double>(result.begin(), result.end());
     };
   }
-  
-  if(templateQuadtree.quadtree){
+  std::function<double (const Matrix&)> fun = makeCombineFun(combineMethod, combineFun, combineArgs);
+  return [fun](const std::vector<Matrix> &mats) -> std::vector<double>{
+    std::vector<double> vals(mats.size());
+    for(size_t i = 0; i < mats.size(); ++i){
+      vals[i] = fun(mats[i]);
+    }
+    return vals;
+  };
+}
+
+// creates the quadtree. If 'templateQuadtree' is given and a built-in combine
+// method is used, the values are calculated in a single pass over 'mat' (see
+// 'Quadtree::getNodeValues()') using 'nThreads' threads - a compiled combine
+// function is also run on 'nThreads' threads, but R functions can only be
+// called from the main thread. If 'vectorized' is true, custom R functions are
+// called once per level of the tree instead of once per cell (see
+// 'makeVectorizedSplitFun()'). The values are then converted to 'valueType'
+// (see 'ValueVector').
+void QuadtreeWrapper::createTree(Rcpp::NumericMatrix &mat, std::string splitMethod, double splitThreshold, std::string combineMethod, SEXP splitFun, Rcpp::List splitArgs, SEXP combineFun, Rcpp::List combineArgs, QuadtreeWrapper templateQuadtree, int nThreads, std::string valueType, bool vectorized){
+  ValueVector::Type type = ValueVector::typeFromString(valueType);
+  Matrix matNew(rInterface::rMatToCppMat(mat));
+  std::function<double (const Matrix&)> combine = makeCombineFun(combineMethod, combineFun, combineArgs);
+  quadtree->combineMethod = combineMethod;
+  if(templateQuadtree.quadtree && (combineMethod != "custom" || isPlugin(combineFun))){
+    quadtree->makeTreeWithTemplate(matNew, templateQuadtree.quadtree, combineMethod, combine, nThreads);
+  } else if(templateQuadtree.quadtree && vectorized){
+    quadtree->makeTreeWithTemplate(matNew, templateQuadtree.quadtree, makeVectorizedCombineFun(combineMethod, combineFun, combineArgs));
+  } else if(templateQuadtree.quadtree){
     quadtree->makeTreeWithTemplate(matNew, templateQuadtree.quadtree, combine);
+  } else if(vectorized){
+    quadtree->makeTreeByLevel({matNew}, makeVectorizedSplitFun(splitMethod, splitThreshold, splitFun, splitArgs, false), makeVectorizedCombineFun(combineMethod, combineFun, combineArgs));
   } else {
-    // set the split function
-    std::function<bool (const Matrix&)> split = [&splitThreshold](const Matrix &mat) -> bool {
-      return Quadtree::splitRange(mat, splitThreshold);
-    };
-    if(splitMethod != "custom"){
-      if(splitMethod == "sd"){
-        split = [&splitThreshold](const Matrix &mat) -> bool {
-          return Quadtree::splitSD(mat, splitThreshold);
-        };
-      } else if(splitMethod == "cv"){
-        split = [&splitThreshold](const Matrix &mat) -> bool {
-          return Quadtree::splitCV(mat, splitThreshold);
-        };
+    quadtree->makeTree(matNew, makeSplitFun(splitMethod, splitThreshold, splitFun, splitArgs), combine);
+  }
+  quadtree->setValueType(type);
+}
+
+// updates the structure of the quadtree after the values at the points given
+// by 'x' and 'y' have changed in 'mat' (see 'Quadtree::restructure()').
+// Returns the number of cells that were split or merged.
+int QuadtreeWrapper::restructure(Rcpp::NumericMatrix &mat, const std::vector<double> &x, const std::vector<double> &y, std::string splitMethod, double splitThreshold, std::string combineMethod, SEXP splitFun, Rcpp::List splitArgs, SEXP combineFun, Rcpp::List combineArgs){
+  Matrix matNew(rInterface::rMatToCppMat(mat));
+  std::vector<Point> pts(x.size());
+  for(size_t i = 0; i < x.size(); ++i){
+    pts[i] = Point(x[i], y[i]);
+  }
+  nbList = Rcpp::List(); // the structure may change, so the cached neighbor list is no longer valid
+  return quadtree->restructure(matNew, pts, makeSplitFun(splitMethod, splitThreshold, splitFun, splitArgs), makeCombineFun(combineMethod, combineFun, combineArgs));
+}
+
+// same as 'makeSplitFun()', but for quadtrees with more than one layer - the
+// built-in methods and compiled functions split a quadrant if the values of
+// any of the layers meet the split rule, and a custom R function is given a
+// matrix with one column per layer
+std::function<bool (const std::vector<Matrix>&)> QuadtreeWrapper::makeLayeredSplitFun(std::string splitMethod, double splitThreshold, SEXP splitFun, Rcpp::List splitArgs){
+  if(splitMethod == "custom" && !isPlugin(splitFun)){
+    Rcpp::Function rFun(splitFun);
+    return [splitArgs, rFun] (const std::vector<Matrix> &mats) -> bool{
+      Rcpp::NumericMatrix vals(mats[0].size(), mats.size());
+      for(size_t i = 0; i < mats.size(); ++i){
+        std::copy(mats[i].vec.begin(), mats[i].vec.end(), vals.begin() + i * mats[0].size());
       }
-    } else {
-      split = [&splitArgs, &splitFun] (const Matrix &mat) -> bool{
-        return Rcpp::as<bool>(splitFun(mat.vec, splitArgs));
-      };
+      return Rcpp::as<bool>(rFun(vals, splitArgs));
+    };
+  }
+  std::function<bool (const Matrix&)> fun = makeSplitFun(splitMethod, splitThreshold, splitFun, splitArgs);
+  return [fun](const std::vector<Matrix> &mats) -> bool {
+    for(auto const &mat : mats){
+      if(fun(mat)) return true;
+    }
+    return false;
+  };
+}
+
+// creates a quadtree with one layer per matrix. If 'splitLayer' is -1, the
+// structure is decided using all of the layers (see 'makeLayeredSplitFun()') -
+// otherwise it's decided using only the layer at that index. 'nThreads' is
+// the number of threads used to calculate the values of each layer (see
+// 'Quadtree::getNodeValues()'), and 'valueType' is the type used to store
+// them. 'vectorized' is the same as for 'createTree()'.
+void QuadtreeWrapper::createLayeredTree(Rcpp::List mats, std::vector<std::string> names, int splitLayer, std::string splitMethod, double splitThreshold, std::string combineMethod, SEXP splitFun, Rcpp::List splitArgs, SEXP combineFun, Rcpp::List combineArgs, QuadtreeWrapper templateQuadtree, int nThreads, std::string valueType, bool vectorized){
+  ValueVector::Type type = ValueVector::typeFromString(valueType);
+  std::vector<Matrix> matsNew;
+  for(int i = 0; i < mats.size(); ++i){
+    Rcpp::NumericMatrix mat = Rcpp::as<Rcpp::NumericMatrix>(mats[i]);
+    matsNew.push_back(rInterface::rMatToCppMat(mat));
+  }
+  if(matsNew.empty()){
+    throw std::runtime_error("at least one layer is required");
+  }
+  if(splitLayer < -1 || splitLayer >= static_cast<int>(matsNew.size())){
+    throw std::runtime_error("invalid split layer: " + std::to_string(splitLayer));
+  }
+  std::function<double (const Matrix&)> combine = makeCombineFun(combineMethod, combineFun, combineArgs);
+  bool rCombine = combineMethod == "custom" && !isPlugin(combineFun);
+  int combineThreads = rCombine ? 1 : nThreads; // R functions can only be called from the main thread
+  quadtree->combineMethod = combineMethod;
+  if(templateQuadtree.quadtree && (!rCombine || vectorized)){
+    quadtree->shareTemplate(matsNew[0], templateQuadtree.quadtree); // the values are set by 'setLayers()'
+  } else if(templateQuadtree.quadtree){
+    quadtree->makeTreeWithTemplate(matsNew[0], templateQuadtree.quadtree, combine);
+  } else if(vectorized && splitLayer == -1){
+    quadtree->makeTreeByLevel(matsNew, makeVectorizedSplitFun(splitMethod, splitThreshold, splitFun, splitArgs, true), nullptr);
+  } else if(vectorized){
+    quadtree->makeTreeByLevel({matsNew[splitLayer]}, makeVectorizedSplitFun(splitMethod, splitThreshold, splitFun, splitArgs, false), nullptr);
+  } else if(splitLayer == -1){
+    quadtree->makeTree(matsNew, makeLayeredSplitFun(splitMethod, splitThreshold, splitFun, splitArgs));
+  } else {
+    quadtree->makeTree(matsNew[splitLayer], makeSplitFun(splitMethod, splitThreshold, splitFun, splitArgs), combine);
+  }
+  quadtree->valueType = type; // set before 'setLayers()' so the layers are only stored once
+  if(rCombine && vectorized){
+    std::function<std::vector<double> (const std::vector<Matrix>&)> vectorizedCombine = makeVectorizedCombineFun(combineMethod, combineFun, combineArgs);
+    std::vector<std::vector<double>> vals;
+    for(auto const &mat : matsNew){
+      vals.push_back(quadtree->getLayerValuesByLevel(mat, vectorizedCombine));
+    }
+    quadtree->setLayers(vals, names);
+  } else {
+    quadtree->setLayers(matsNew, names, combineMethod, combine, combineThreads);
+  }
+}
+
+// adds a layer to the quadtree (see 'Quadtree::addLayer()'). 'vectorized' is
+// the same as for 'createTree()'.
+void QuadtreeWrapper::addLayer(Rcpp::NumericMatrix &mat, std::string name, std::string combineMethod, SEXP combineFun, Rcpp::List combineArgs, bool vectorized){
+  if(vectorized && combineMethod == "custom" && !isPlugin(combineFun)){
+    quadtree->addLayer(quadtree->getLayerValuesByLevel(rInterface::rMatToCppMat(mat), makeVectorizedCombineFun(combineMethod, combineFun, combineArgs)), name);
+  } else {
+    quadtree->addLayer(rInterface::rMatToCppMat(mat), name, combineMethod, makeCombineFun(combineMethod, combineFun, combineArgs));
+  }
+}
+
+std::vector<std::string> QuadtreeWrapper::getLayerNames() const{
+  if(quadtree->layerNames.empty()){
+    return std::vector<std::string>{"layer1"};
+  }
+  return quadtree->layerNames;
+}
+
+int QuadtreeWrapper::getActiveLayer() const{
+  return quadtree->activeLayer;
+}
+
+std::string QuadtreeWrapper::getValueType() const{
+  return ValueVector::typeToString(quadtree->valueType);
+}
+
+void QuadtreeWrapper::setActiveLayer(int layer){
+  nbList = Rcpp::List(); // the cached neighbor list contains the values of the old layer
+  quadtree->setActiveLayer(layer);
+}
+
+// gets the values of several layers at a set of points. Returns a matrix with
+// one row per point and one column per layer.
+Rcpp::NumericMatrix QuadtreeWrapper::getLayerValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<int> &layers) const{
+  Rcpp::NumericMatrix vals(x.size(), layers.size());
+  for(size_t i = 0; i < x.size(); ++i){
+    std::shared_ptr<Node> node = quadtree->getNode(Point(x[i], y[i]));
+    for(size_t j = 0; j < layers.size(); ++j){
+      vals(i, j) = node ? quadtree->getLayerValue(*node, layers[j]) : std::numeric_limits<double>::quiet_NaN();
     }
-    
-    quadtree->makeTree(matNew, split, combine);
   }
+  return vals;
 }
 
 std::vector<double> QuadtreeWrapper::getValues(const std::vector<double> &x, const std::vector<double> &y) const{
@@ -160,11 +444,243 @@ Rcpp::NumericMatrix QuadtreeWrapper::getNeighbors(Rcpp::NumericVector pt) const{
   return mat;
 }
 
-void QuadtreeWrapper::setValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &newVals){
+// labels the connected components of the non-NA cells (see
+// 'LeafGraph::getComponents()'). Components are numbered starting from 1 and
+// NA cells get a component of NA.
+Rcpp::NumericMatrix QuadtreeWrapper::getComponents(int nThreads) const{
+  LeafGraph graph(*quadtree);
+  std::vector<int> components = graph.getComponents(nThreads);
+  Rcpp::NumericMatrix mat(graph.size(), 2);
+  colnames(mat) = Rcpp::CharacterVector({"id","component"}); //name the columns
+  for(int i = 0; i < graph.size(); ++i){
+    mat(i,0) = graph.leaves[i]->id;
+    mat(i,1) = components[i] == -1 ? std::numeric_limits<double>::quiet_NaN() : components[i] + 1;
+  }
+  return mat;
+}
+
+// same as 'getComponents()', but returns a copy of the quadtree where the
+// value of each cell is its component. The values of the non-leaf nodes are
+// set to NA, since they don't have a meaningful component.
+QuadtreeWrapper QuadtreeWrapper::getComponentsQuadtree(int nThreads) const{
+  QuadtreeWrapper qtw = copy();
+  qtw.quadtree->detach(); // we're about to change the values directly
+  LeafGraph graph(*qtw.quadtree);
+  std::vector<int> components = graph.getComponents(nThreads);
+  std::function<void (const std::shared_ptr<Node>&)> clear = [&clear](const std::shared_ptr<Node> &node){
+    if(node->hasChildren){
+      node->value = std::numeric_limits<double>::quiet_NaN();
+      for(auto const &child : node->children){
+        clear(child);
+      }
+    }
+  };
+  clear(qtw.quadtree->root);
+  for(int i = 0; i < graph.size(); ++i){
+    graph.leaves[i]->value = components[i] == -1 ? std::numeric_limits<double>::quiet_NaN() : components[i] + 1;
+  }
+  return qtw;
+}
+
+// finds the least-cost corridor between two points - for every cell, the cost
+// of the cheapest path from 'pointA' to 'pointB' that passes through that cell.
+// Both searches use the same graph, and the results are combined by the dense
+// leaf index, so no joining on IDs is needed. If 'tolerance' is not negative,
+// only the cells whose corridor cost is within 'tolerance' (a proportion) of
+// the cost of the LCP are returned. Cells that can't be reached from both
+// points are never returned.
+Rcpp::NumericMatrix QuadtreeWrapper::getCorridor(Rcpp::NumericVector pointA, Rcpp::NumericVector pointB, double tolerance, int nThreads) const{
+  LeafGraph graph(*quadtree);
+  graph.makeEdgeCosts();
+  std::shared_ptr<Node> nodes[2] = {quadtree->getNode(Point(pointA[0], pointA[1])), quadtree->getNode(Point(pointB[0], pointB[1]))};
+  std::vector<double> costs[2];
+  std::vector<double> dists[2];
+  parallel::forRange(2, nThreads, [&](int begin, int end, int thread){ // the two searches are independent, so they can be run at the same time
+    for(int i = begin; i < end; ++i){
+      graph.getCostDistances(nodes[i] ? graph.indices.get(nodes[i]->id) : -1, costs[i], dists[i]);
+    }
+  });
+
+  int indexB = nodes[1] ? graph.indices.get(nodes[1]->id) : -1;
+  double lcpCost = indexB == -1 ? std::numeric_limits<double>::infinity() : costs[0][indexB];
+  double maxCost = tolerance < 0 ? std::numeric_limits<double>::infinity() : lcpCost * (1 + tolerance);
+  std::vector<int> rows;
+  for(int i = 0; i < graph.size(); ++i){
+    double cost = costs[0][i] + costs[1][i];
+    if(cost < std::numeric_limits<double>::infinity() && cost <= maxCost){
+      rows.push_back(i);
+    }
+  }
+
+  Rcpp::NumericMatrix mat(rows.size(), 9);
+  colnames(mat) = Rcpp::CharacterVector({"id","xmin","xmax","ymin","ymax","value","cost_a","cost_b","cost"}); //name the columns
+  for(size_t r = 0; r < rows.size(); ++r){
+    auto node = graph.leaves[rows[r]];
+    mat(r,0) = node->id;
+    mat(r,1) = node->xMin;
+    mat(r,2) = node->xMax;
+    mat(r,3) = node->yMin;
+    mat(r,4) = node->yMax;
+    mat(r,5) = node->value;
+    mat(r,6) = costs[0][rows[r]];
+    mat(r,7) = costs[1][rows[r]];
+    mat(r,8) = costs[0][rows[r]] + costs[1][rows[r]];
+  }
+  return mat;
+}
+
+// counts the number of LCPs that pass through each cell (see
+// 'LeafGraph::getBetweenness()'). If 'points' has any rows, the paths between
+// every pair of cells containing the points are used. Otherwise the paths
+// between every pair of non-NA cells are used - if 'nSamples' is positive,
+// only 'nSamples' randomly chosen cells are used as sources, and the counts
+// are scaled up so that they estimate the counts for all sources.
+Rcpp::NumericMatrix QuadtreeWrapper::getBetweenness(Rcpp::NumericMatrix points, int nSamples, int seed, int nThreads) const{
+  LeafGraph graph(*quadtree);
+  graph.makeEdgeCosts();
+  std::vector<int> sources;
+  std::vector<char> isTarget(graph.size(), 0);
+  double scale{1};
+  if(points.nrow() > 0){
+    for(int i = 0; i < points.nrow(); ++i){
+      auto node = quadtree->getNode(Point(points(i,0), points(i,1)));
+      int index = node ? graph.indices.get(node->id) : -1;
+      if(index != -1 && !std::isnan(node->value) && !isTarget[index]){
+        isTarget[index] = 1;
+        sources.push_back(index);
+      }
+    }
+  } else {
+    for(int i = 0; i < graph.size(); ++i){
+      if(!std::isnan(graph.leaves[i]->value)){
+        isTarget[i] = 1;
+        sources.push_back(i);
+      }
+    }
+    if(nSamples > 0 && nSamples < static_cast<int>(sources.size())){
+      std::mt19937 rng(seed);
+      for(int i = 0; i < nSamples; ++i){ // partial Fisher-Yates shuffle
+        std::uniform_int_distribution<int> dist(i, sources.size() - 1);
+        std::swap(sources[i], sources[dist(rng)]);
+      }
+      scale = static_cast<double>(sources.size()) / nSamples;
+      sources.resize(nSamples);
+    }
+  }
+  std::vector<double> scores = graph.getBetweenness(sources, isTarget, nThreads);
+
+  Rcpp::NumericMatrix mat(graph.size(), 2);
+  colnames(mat) = Rcpp::CharacterVector({"id","betweenness"}); //name the columns
+  for(int i = 0; i < graph.size(); ++i){
+    mat(i,0) = graph.leaves[i]->id;
+    mat(i,1) = std::isnan(graph.leaves[i]->value) ? std::numeric_limits<double>::quiet_NaN() : scores[i] * scale;
+  }
+  return mat;
+}
+
+// simulates random walkers moving between neighboring cells (see
+// 'RandomWalker'). One walker starts from each row of 'startPoints'. Returns
+// the number of visits to each cell and, if 'getTrajectories' is true, the
+// cell each walker was in after each step (in long format - one row per
+// walker per step, ending when the walker stops).
+Rcpp::List QuadtreeWrapper::randomWalk(Rcpp::NumericMatrix startPoints, int nSteps, std::string kernel, double bias, bool getTrajectories, int seed, int nThreads) const{
+  LeafGraph graph(*quadtree);
+  RandomWalker walker(graph, kernel, bias);
+  std::vector<int> starts(startPoints.nrow());
+  for(int i = 0; i < startPoints.nrow(); ++i){
+    auto node = quadtree->getNode(Point(startPoints(i,0), startPoints(i,1)));
+    starts[i] = node ? graph.indices.get(node->id) : -1;
+  }
+  std::vector<double> visits;
+  std::vector<int> trajectories;
+  walker.walk(starts, nSteps, static_cast<uint32_t>(seed), nThreads, visits, getTrajectories ? &trajectories : nullptr);
+
+  Rcpp::NumericMatrix visitMat(graph.size(), 2);
+  colnames(visitMat) = Rcpp::CharacterVector({"id","visits"}); //name the columns
+  for(int i = 0; i < graph.size(); ++i){
+    visitMat(i,0) = graph.leaves[i]->id;
+    visitMat(i,1) = visits[i];
+  }
+  if(!getTrajectories){
+    return Rcpp::List::create(Rcpp::Named("visits") = visitMat, Rcpp::Named("trajectories") = R_NilValue);
+  }
+
+  int nRows = std::count_if(trajectories.begin(), trajectories.end(), [](int i){ return i != -1; });
+  Rcpp::NumericMatrix trajMat(nRows, 3);
+  colnames(trajMat) = Rcpp::CharacterVector({"walker","step","id"}); //name the columns
+  int row{0};
+  for(size_t w = 0; w < starts.size(); ++w){
+    for(int step = 0; step <= nSteps; ++step){
+      int i = trajectories[w * (nSteps + 1) + step];
+      if(i == -1) break;
+      trajMat(row,0) = w + 1;
+      trajMat(row,1) = step;
+      trajMat(row,2) = graph.leaves[i]->id;
+      ++row;
+    }
+  }
+  return Rcpp::List::create(Rcpp::Named("visits") = visitMat, Rcpp::Named("trajectories") = trajMat);
+}
+
+// treats the quadtree as an electrical circuit and calculates the effective
+// resistance between each pair of points and the total current through each
+// cell (see 'CircuitSolver::getPairwise()')
+Rcpp::List QuadtreeWrapper::getCircuitConnectivity(Rcpp::NumericMatrix points, double tolerance, int nThreads) const{
+  LeafGraph graph(*quadtree);
+  CircuitSolver solver(graph);
+  solver.tolerance = tolerance;
+  solver.nThreads = nThreads;
+  std::vector<int> nodes(points.nrow());
+  for(int i = 0; i < points.nrow(); ++i){
+    auto node = quadtree->getNode(Point(points(i,0), points(i,1)));
+    nodes[i] = node ? graph.indices.get(node->id) : -1;
+  }
+  std::vector<double> resistances;
+  std::vector<double> currents;
+  solver.getPairwise(nodes, resistances, currents);
+
+  Rcpp::NumericMatrix resMat(nodes.size(), nodes.size());
+  for(size_t i = 0; i < nodes.size(); ++i){
+    for(size_t j = 0; j < nodes.size(); ++j){
+      resMat(i,j) = resistances[i * nodes.size() + j];
+    }
+  }
+  Rcpp::NumericMatrix curMat(graph.size(), 2);
+  colnames(curMat) = Rcpp::CharacterVector({"id","current"}); //name the columns
+  for(int i = 0; i < graph.size(); ++i){
+    curMat(i,0) = graph.leaves[i]->id;
+    curMat(i,1) = currents[i];
+  }
+  return Rcpp::List::create(Rcpp::Named("resistance") = resMat, Rcpp::Named("current") = curMat);
+}
+
+// changes the values of the cells containing the points. If 'combineMethod'
+// is not empty, the values of the ancestors of the changed cells are updated
+// using that method - "tree" means the method used to create the quadtree.
+void QuadtreeWrapper::setValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &newVals, std::string combineMethod){
   //assert(x.size() == y.size() && y.size() == newVals.size());
+  std::function<double (const Matrix&)> combine{nullptr};
+  if(combineMethod == "tree"){
+    combineMethod = quadtree->combineMethod;
+    if(combineMethod == "" || combineMethod == "custom"){
+      throw std::runtime_error("the combine method used to create the quadtree is unknown - it must be specified");
+    }
+  }
+  if(combineMethod != ""){
+    // the ancestors are recalculated from the values of their children, which
+    // only gives the same value as creating the quadtree again for these
+    // methods - the median or mode of the children's medians or modes isn't
+    // the median or mode of all the values (see 'Quadtree::updateAncestors()')
+    if(combineMethod != "mean" && combineMethod != "min" && combineMethod != "max"){
+      throw std::runtime_error("the values of ancestors can't be updated using the '" + combineMethod + "' combine method - only 'mean', 'min', and 'max' can be used");
+    }
+    combine = Quadtree::getCombineFun(combineMethod);
+  }
+  std::vector<Point> pts(x.size());
   for(size_t i = 0; i < x.size(); ++i){
-    quadtree->setValue(Point(x[i], y[i]), newVals[i]);
+    pts[i] = Point(x[i], y[i]);
   }
+  quadtree->setValues(pts, newVals, combine);
 }
 
 void QuadtreeWrapper::transformValues(Rcpp::Function transformFun){
@@ -174,6 +690,22 @@ void QuadtreeWrapper::transformValues(Rcpp::Function transformFun){
   quadtree->transformValues(transform);
 }
 
+// same as 'transformValues()', but 'transformFun' is only called once, with a
+// vector of all the values, and must return a vector of the same length
+void QuadtreeWrapper::transformValuesVectorized(Rcpp::Function transformFun){
+  quadtree->transformValuesVector([&transformFun](std::vector<double> &vals){
+    vals = Rcpp::as<std::vector<double>>(transformFun(Rcpp::wrap(vals)));
+  });
+}
+
+// transforms the values of all cells using one of the built-in kernels (see
+// 'TransformKernels.h')
+void QuadtreeWrapper::transformValuesKernel(std::string kernel, std::vector<double> params, std::vector<double> table1, std::vector<double> table2){
+  quadtree->transformValuesVector([&](std::vector<double> &vals){
+    transformKernels::apply(vals, kernel, params, table1, table2);
+  });
+}
+
 NodeWrapper QuadtreeWrapper::getCell(Rcpp::NumericVector pt) const{
   return NodeWrapper(quadtree->getNode(Point(pt[0], pt[1])));
 }
@@ -282,8 +814,12 @@ Rcpp::List QuadtreeWrapper::getNeighborList(){
 //   return LcpFinderWrapper(quadtree, startPoint, xlims, ylims, searchByCentroid);
 // }
 
+// the LcpFinder gets its own copy of the quadtree (which takes constant time -
+// see 'Quadtree::copy()'). It keeps pointers to the nodes and looks cells up
+// by ID, so if it shared the quadtree, changing the structure of the quadtree
+// (e.g. with 'restructure()') would leave it pointing at deleted nodes
 LcpFinderWrapper QuadtreeWrapper::getLcpFinder(Rcpp::NumericVector startPoint, Rcpp::NumericVector xlims, Rcpp::NumericVector ylims, Rcpp::NumericMatrix newPoints, bool searchByCentroid) const{
-  return LcpFinderWrapper(quadtree, startPoint, xlims, ylims, newPoints, searchByCentroid);
+  return LcpFinderWrapper(quadtree->copy(), startPoint, xlims, ylims, newPoints, searchByCentroid);
 }
 
 QuadtreeWrapper QuadtreeWrapper::copy() const{
@@ -300,21 +836,112 @@ QuadtreeWrapper QuadtreeWrapper::copy() const{
   return(qtw);
 }
 
+// writes the quadtree using 'cereal', after the header that every file
+// starts with (see 'QuadtreeInfo')
 void QuadtreeWrapper::writeQuadtree(QuadtreeWrapper qw, std::string filePath){
-  std::ofstream os(filePath, std::ios::binary);
-  cereal::PortableBinaryOutputArchive oarchive(os);
-  oarchive(qw);
+  QuadtreeInfo info = QuadtreeInfo::fromQuadtree(*qw.quadtree, {qw.originalXMin, qw.originalXMax, qw.originalYMin, qw.originalYMax, qw.originalNX, qw.originalNY}, QuadtreeInfo::Format::Cereal);
+  QuadtreeInfo::writeFile(filePath, info, [&](std::ostream &os){
+    cereal::PortableBinaryOutputArchive oarchive(os);
+    oarchive(qw);
+    qw.quadtree->saveLayers(oarchive);
+  });
 }
 
+// reads a file written by 'writeQuadtree()', 'writeQuadtreeFlat()', or
+// 'writeQuadtreeCompact()'. Files written before headers were added don't
+// have one, and are always 'cereal' files.
 QuadtreeWrapper QuadtreeWrapper::readQuadtree(std::string filePath){
+  QuadtreeInfo info;
+  if(QuadtreeInfo::hasInfo(filePath)) info = QuadtreeInfo::read(filePath);
+  if(info.format == QuadtreeInfo::Format::Flat){
+    return MappedQuadtreeWrapper::mapQuadtree(filePath).toQuadtree();
+  }
+  if(info.format == QuadtreeInfo::Format::Compact){
+    QuadtreeWrapper qw(CompactQuadtree::readQuadtree(filePath));
+    qw.setOriginalValues(info.original[0], info.original[1], info.original[2], info.original[3], info.original[4], info.original[5]);
+    return qw;
+  }
   std::ifstream is(filePath, std::ios::binary);
+  if(!is) throw std::runtime_error("unable to open '" + filePath + "'");
+  is.seekg(info.headerSize);
   cereal::PortableBinaryInputArchive iarchive(is);
   QuadtreeWrapper qw;
   iarchive(qw);
+  qw.quadtree->loadLayers(iarchive, is);
   qw.quadtree->assignNeighbors();
   return qw;
 }
 
+// reads the part of a quadtree in a flat file that overlaps 'xlim' and 'ylim'
+// (see 'FlatQuadtree::readWindow()')
+QuadtreeWrapper QuadtreeWrapper::readQuadtreeWindow(std::string filePath, std::vector<double> xlim, std::vector<double> ylim){
+  if(!FlatQuadtree::isFlatFile(filePath)){
+    throw std::runtime_error("can't read part of '" + filePath + "' - only files written with format = \"flat\" can be read partially");
+  }
+  FlatQuadtree::Header head = FlatQuadtree::readHeader(filePath);
+  QuadtreeWrapper qw(FlatQuadtree::readWindow(filePath, xlim[0], xlim[1], ylim[0], ylim[1]));
+  qw.setOriginalValues(head.originalXMin, head.originalXMax, head.originalYMin, head.originalYMax, head.originalNX, head.originalNY);
+  return qw;
+}
+
 void QuadtreeWrapper::writeQuadtreePtr(QuadtreeWrapper qw, std::string filePath){
   Quadtree::writeQuadtree(qw.quadtree, filePath);
-}
\ No newline at end of file
+}
+
+// writes the quadtree in the flat format (see 'FlatQuadtree.h'), which can be
+// used without reading it into memory (see 'MappedQuadtreeWrapper')
+void QuadtreeWrapper::writeQuadtreeFlat(QuadtreeWrapper qw, std::string filePath){
+  FlatQuadtree::writeQuadtree(*qw.quadtree, filePath, {qw.originalXMin, qw.originalXMax, qw.originalYMin, qw.originalYMax, qw.originalNX, qw.originalNY});
+}
+
+// writes the quadtree in the compact format (see 'CompactQuadtree.h'), which
+// is much smaller than the other formats
+void QuadtreeWrapper::writeQuadtreeCompact(QuadtreeWrapper qw, std::string filePath, double precision){
+  CompactQuadtree::writeQuadtree(*qw.quadtree, filePath, {qw.originalXMin, qw.originalXMax, qw.originalYMin, qw.originalYMax, qw.originalNX, qw.originalNY}, precision);
+}
+
+// returns the information stored in the header of a file (see
+// 'QuadtreeInfo') - only the header is read. If 'check' is true, the rest of
+// the file is also read to check it against the checksum in the header. Files
+// written before headers were added have to be read completely.
+Rcpp::List QuadtreeWrapper::quadtreeInfo(std::string filePath, bool check){
+  QuadtreeInfo info;
+  Rcpp::LogicalVector valid = Rcpp::LogicalVector::create(NA_LOGICAL);
+  if(QuadtreeInfo::hasInfo(filePath)){
+    info = QuadtreeInfo::read(filePath);
+    if(check) valid[0] = info.checkData(filePath);
+  } else {
+    QuadtreeWrapper qw = readQuadtree(filePath);
+    info = QuadtreeInfo::fromQuadtree(*qw.quadtree, {qw.originalXMin, qw.originalXMax, qw.originalYMin, qw.originalYMax, qw.originalNX, qw.originalNY}, QuadtreeInfo::Format::Cereal);
+    info.version = 0;
+  }
+
+  int nLayers = info.layers.size();
+  Rcpp::CharacterVector names(nLayers);
+  Rcpp::NumericVector nNA(nLayers), min(nLayers), max(nLayers), mean(nLayers);
+  for(int i = 0; i < nLayers; ++i){
+    names[i] = info.layers[i].name.empty() ? "layer" + std::to_string(i + 1) : info.layers[i].name; // same as 'getLayerNames()'
+    nNA[i] = info.layers[i].nNA;
+    min[i] = info.layers[i].min;
+    max[i] = info.layers[i].max;
+    mean[i] = info.layers[i].mean;
+  }
+  Rcpp::DataFrame layers = Rcpp::DataFrame::create(Rcpp::Named("name") = names, Rcpp::Named("n_na") = nNA,
+    Rcpp::Named("min") = min, Rcpp::Named("max") = max, Rcpp::Named("mean") = mean, Rcpp::Named("stringsAsFactors") = false);
+
+  return Rcpp::List::create(
+    Rcpp::Named("format") = QuadtreeInfo::formatToString(info.format),
+    Rcpp::Named("version") = static_cast<int>(info.version),
+    Rcpp::Named("n_cells") = static_cast<double>(info.nLeaves),
+    Rcpp::Named("n_nodes") = static_cast<double>(info.nNodes),
+    Rcpp::Named("extent") = Rcpp::NumericVector::create(Rcpp::Named("xmin", info.xMin), Rcpp::Named("xmax", info.xMax), Rcpp::Named("ymin", info.yMin), Rcpp::Named("ymax", info.yMax)),
+    Rcpp::Named("original_extent") = Rcpp::NumericVector::create(Rcpp::Named("xmin", info.original[0]), Rcpp::Named("xmax", info.original[1]), Rcpp::Named("ymin", info.original[2]), Rcpp::Named("ymax", info.original[3])),
+    Rcpp::Named("original_dim") = Rcpp::NumericVector::create(Rcpp::Named("nX", info.original[4]), Rcpp::Named("nY", info.original[5])),
+    Rcpp::Named("min_cell_size") = Rcpp::NumericVector::create(Rcpp::Named("x", info.minXCellLength), Rcpp::Named("y", info.minYCellLength)),
+    Rcpp::Named("max_cell_size") = Rcpp::NumericVector::create(Rcpp::Named("x", info.maxXCellLength), Rcpp::Named("y", info.maxYCellLength)),
+    Rcpp::Named("projection") = info.projection,
+    Rcpp::Named("value_type") = ValueVector::typeToString(info.valueType),
+    Rcpp::Named("active_layer") = info.activeLayer,
+    Rcpp::Named("layers") = layers,
+    Rcpp::Named("valid") = valid);
+}
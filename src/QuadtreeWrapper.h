@@ -10,6 +10,7 @@
 #include <cereal/types/memory.hpp>
 #include <Rcpp.h>
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -48,14 +49,35 @@ class QuadtreeWrapper{
     std::string getProjection() const;
     std::vector<double> getValues(const std::vector<double> &x, const std::vector<double> &y) const;
     Rcpp::NumericMatrix getNeighbors(Rcpp::NumericVector pt) const;
+    Rcpp::NumericMatrix getComponents(int nThreads) const;
+    QuadtreeWrapper getComponentsQuadtree(int nThreads) const;
+    Rcpp::NumericMatrix getBetweenness(Rcpp::NumericMatrix points, int nSamples, int seed, int nThreads) const;
+    Rcpp::List randomWalk(Rcpp::NumericMatrix startPoints, int nSteps, std::string kernel, double bias, bool getTrajectories, int seed, int nThreads) const;
+    Rcpp::List getCircuitConnectivity(Rcpp::NumericMatrix points, double tolerance, int nThreads) const;
+    Rcpp::NumericMatrix getCorridor(Rcpp::NumericVector pointA, Rcpp::NumericVector pointB, double tolerance, int nThreads) const;
     
-    void setValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &newVals);
+    void setValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &newVals, std::string combineMethod);
     void transformValues(Rcpp::Function transformFun);
+    void transformValuesVectorized(Rcpp::Function transformFun);
+    void transformValuesKernel(std::string kernel, std::vector<double> params, std::vector<double> table1, std::vector<double> table2);
     NodeWrapper getCell(Rcpp::NumericVector pt) const;
     Rcpp::List getCells(Rcpp::NumericVector x, Rcpp::NumericVector y) const;
     Rcpp::NumericMatrix getCellsDetails(Rcpp::NumericVector x, Rcpp::NumericVector y) const;
 
-    void createTree(Rcpp::NumericMatrix &mat, std::string splitMethod, double splitThreshold, std::string combineMethod, Rcpp::Function splitFun, Rcpp::List splitArgs, Rcpp::Function combineFun, Rcpp::List combineArgs, QuadtreeWrapper templateQuadtree);
+    static std::function<bool (const Matrix&)> makeSplitFun(std::string splitMethod, double splitThreshold, SEXP splitFun, Rcpp::List splitArgs);
+    static std::function<bool (const std::vector<Matrix>&)> makeLayeredSplitFun(std::string splitMethod, double splitThreshold, SEXP splitFun, Rcpp::List splitArgs);
+    static std::function<double (const Matrix&)> makeCombineFun(std::string combineMethod, SEXP combineFun, Rcpp::List combineArgs);
+    static std::function<std::vector<bool> (const std::vector<std::vector<Matrix>>&)> makeVectorizedSplitFun(std::string splitMethod, double splitThreshold, SEXP splitFun, Rcpp::List splitArgs, bool layered);
+    static std::function<std::vector<double> (const std::vector<Matrix>&)> makeVectorizedCombineFun(std::string combineMethod, SEXP combineFun, Rcpp::List combineArgs);
+    void createTree(Rcpp::NumericMatrix &mat, std::string splitMethod, double splitThreshold, std::string combineMethod, SEXP splitFun, Rcpp::List splitArgs, SEXP combineFun, Rcpp::List combineArgs, QuadtreeWrapper templateQuadtree, int nThreads, std::string valueType, bool vectorized);
+    int restructure(Rcpp::NumericMatrix &mat, const std::vector<double> &x, const std::vector<double> &y, std::string splitMethod, double splitThreshold, std::string combineMethod, SEXP splitFun, Rcpp::List splitArgs, SEXP combineFun, Rcpp::List combineArgs);
+    void createLayeredTree(Rcpp::List mats, std::vector<std::string> names, int splitLayer, std::string splitMethod, double splitThreshold, std::string combineMethod, SEXP splitFun, Rcpp::List splitArgs, SEXP combineFun, Rcpp::List combineArgs, QuadtreeWrapper templateQuadtree, int nThreads, std::string valueType, bool vectorized);
+    void addLayer(Rcpp::NumericMatrix &mat, std::string name, std::string combineMethod, SEXP combineFun, Rcpp::List combineArgs, bool vectorized);
+    std::vector<std::string> getLayerNames() const;
+    int getActiveLayer() const;
+    std::string getValueType() const;
+    void setActiveLayer(int layer);
+    Rcpp::NumericMatrix getLayerValues(const std::vector<double> &x, const std::vector<double> &y, const std::vector<int> &layers) const;
     std::string print() const;
     void makeList(std::shared_ptr<Node> node, Rcpp::List &list, int parentID) const;
     Rcpp::List asList();
@@ -71,7 +93,11 @@ class QuadtreeWrapper{
     
     static void writeQuadtree(QuadtreeWrapper qw, std::string filePath);
     static QuadtreeWrapper readQuadtree(std::string filePath);
+    static QuadtreeWrapper readQuadtreeWindow(std::string filePath, std::vector<double> xlim, std::vector<double> ylim);
     static void writeQuadtreePtr(QuadtreeWrapper qw, std::string filePath);
+    static void writeQuadtreeFlat(QuadtreeWrapper qw, std::string filePath);
+    static void writeQuadtreeCompact(QuadtreeWrapper qw, std::string filePath, double precision);
+    static Rcpp::List quadtreeInfo(std::string filePath, bool check);
     
     template<class Archive>
     void serialize(Archive & archive){ //couldn't get serialization to work unless I defined 'serialize' in the header rather than in 'Quadtree.cpp'
@@ -0,0 +1,104 @@
+#include "RandomWalker.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+// ------- RandomWalker -------
+// calculates the step probability table. 'graph' isn't const because the
+// "cost" kernel needs the edge costs, which are calculated if they haven't
+// been already.
+RandomWalker::RandomWalker(LeafGraph &_graph, const std::string &kernel, double bias) : graph{_graph} {
+    if(kernel != "value" && kernel != "cost" && kernel != "uniform"){
+        throw std::runtime_error("invalid kernel: '" + kernel + "' - must be 'value', 'cost', or 'uniform'");
+    }
+    if(kernel == "cost" && _graph.edgeCosts.size() != _graph.adjacency.size()){
+        _graph.makeEdgeCosts();
+    }
+    cumProbs.assign(graph.adjacency.size(), 0);
+    for(int i = 0; i < graph.size(); ++i){
+        double total{0};
+        for(int k = graph.offsets[i]; k < graph.offsets[i + 1]; ++k){
+            double weight{1};
+            if(kernel == "value"){
+                double value = graph.leaves[graph.adjacency[k]]->value;
+                if(value < 0){
+                    throw std::runtime_error("cell values must be non-negative to be used as weights");
+                }
+                if(value == 0 && bias < 0){ // 0 ^ bias would be infinite
+                    throw std::runtime_error("cell values must be greater than 0 to be used as weights when 'bias' is negative");
+                }
+                weight = std::pow(value, bias);
+            } else if(kernel == "cost"){
+                if(graph.edgeCosts[k] <= 0){
+                    throw std::runtime_error("cell values must be greater than 0 to be used as costs");
+                }
+                weight = std::pow(graph.edgeCosts[k], -bias);
+            }
+            total += weight;
+            cumProbs[k] = total;
+        }
+        for(int k = graph.offsets[i]; k < graph.offsets[i + 1]; ++k){
+            cumProbs[k] = total > 0 ? cumProbs[k] / total : 0;
+        }
+    }
+}
+
+// ------- walk -------
+// runs one walker from each starting leaf
+// PARAMETERS:
+//   starts -> indices (in 'graph.leaves') of the starting leaf of each walker.
+//      Walkers with an index of -1 (or that start in an NA leaf) don't move
+//      and don't visit any cells
+//   nSteps -> the number of steps each walker takes
+//   seed -> the seed for the random number generators
+//   nThreads -> the number of threads to use
+//   visits -> filled with the number of times each leaf was visited. The
+//      starting cell counts as a visit
+//   trajectories -> optional; if not null, filled with a
+//      'starts.size()' by 'nSteps + 1' matrix (stored by row) of the index of
+//      the leaf each walker was in after each step. Steps after a walker
+//      stopped are -1
+void RandomWalker::walk(const std::vector<int> &starts, int nSteps, uint32_t seed, int nThreads, std::vector<double> &visits, std::vector<int> *trajectories) const{
+    int n = graph.size();
+    int nWalkers = starts.size();
+    if(trajectories) trajectories->assign(static_cast<size_t>(nWalkers) * (nSteps + 1), -1);
+    nThreads = parallel::getNThreads(nThreads, nWalkers);
+    // the buffers are sized here rather than in the threads, since no threads
+    // are run if there aren't any walkers
+    std::vector<std::vector<double>> threadVisits(nThreads, std::vector<double>(n, 0));
+    parallel::forRange(nWalkers, nThreads, [&](int begin, int end, int thread){
+        std::vector<double> &counts = threadVisits[thread];
+        std::mt19937 rng;
+        for(int w = begin; w < end; ++w){
+            int i = starts[w];
+            if(i < 0 || i >= n || std::isnan(graph.leaves[i]->value)) continue;
+            std::seed_seq seq{seed, static_cast<uint32_t>(w)};
+            rng.seed(seq);
+            int *path = trajectories ? trajectories->data() + static_cast<size_t>(w) * (nSteps + 1) : nullptr;
+            ++counts[i];
+            if(path) path[0] = i;
+            for(int step = 1; step <= nSteps; ++step){
+                int first = graph.offsets[i];
+                int last = graph.offsets[i + 1];
+                if(first == last || cumProbs[last - 1] == 0) break; // nowhere to go
+                // uniform number in (0, 1) - computed directly from the bits so
+                // the walks are the same on every platform
+                double u = (static_cast<double>(rng()) + 0.5) / 4294967296.0;
+                int k = std::upper_bound(cumProbs.begin() + first, cumProbs.begin() + last, u) - cumProbs.begin();
+                if(k == last) k = last - 1; // guard against rounding in the last cumulative probability
+                i = graph.adjacency[k];
+                ++counts[i];
+                if(path) path[step] = i;
+            }
+        }
+    });
+    visits.assign(n, 0);
+    for(auto const &counts : threadVisits){
+        for(int i = 0; i < n; ++i){
+            visits[i] += counts[i];
+        }
+    }
+}
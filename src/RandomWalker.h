@@ -0,0 +1,40 @@
+#ifndef RANDOMWALKER_H
+#define RANDOMWALKER_H
+
+#include "LeafGraph.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// simulates random walkers that move between neighboring leaves of a quadtree.
+// At each step a walker moves from its current cell to one of the cell's
+// neighbors, with the probability of each neighbor given by the "kernel":
+//   "value" -> proportional to 'value ^ bias' (walkers prefer cells with high
+//      values, e.g. habitat quality)
+//   "cost" -> proportional to 'cost ^ -bias', where 'cost' is the cost of the
+//      edge as calculated by 'LcpFinder' (walkers prefer cheap moves, e.g. on
+//      a resistance surface)
+//   "uniform" -> every neighbor is equally likely
+// If all of the neighbors of a cell have a weight of 0 (or the cell has no
+// neighbors), a walker that reaches it stops.
+//
+// The probabilities only depend on the cell, so they're calculated once (when
+// the walker is created) and stored as a cumulative probability table with the
+// same layout as 'graph.adjacency' - choosing a step is then a binary search
+// within the current cell's row.
+//
+// The walkers are split between the threads. Each walker gets its own random
+// number generator seeded from the seed and the walker's index, so the walks
+// don't depend on the number of threads.
+class RandomWalker{
+public:
+    const LeafGraph &graph;
+    std::vector<double> cumProbs; // cumulative probability of each edge within its row - same order as 'graph.adjacency'
+
+    RandomWalker(LeafGraph &_graph, const std::string &kernel, double bias);
+
+    void walk(const std::vector<int> &starts, int nSteps, uint32_t seed, int nThreads, std::vector<double> &visits, std::vector<int> *trajectories = nullptr) const;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "TransformKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace transformKernels {
+    // throws an error if 'params' doesn't have 'n' elements
+    static void checkParams(const std::string &kernel, const std::vector<double> &params, size_t n){
+        if(params.size() != n){
+            throw std::runtime_error("the '" + kernel + "' kernel needs " + std::to_string(n) + " parameter(s), but " + std::to_string(params.size()) + " were given");
+        }
+    }
+
+    void apply(std::vector<double> &vals, const std::string &kernel, const std::vector<double> &params, const std::vector<double> &table1, const std::vector<double> &table2){
+        double *v = vals.data();
+        size_t n = vals.size();
+        if(kernel == "scale"){
+            checkParams(kernel, params, 2);
+            double a = params[0];
+            double b = params[1];
+            for(size_t i = 0; i < n; ++i) v[i] = v[i] * a + b;
+        } else if(kernel == "clamp"){
+            checkParams(kernel, params, 2);
+            double lo = params[0];
+            double hi = params[1];
+            for(size_t i = 0; i < n; ++i) v[i] = v[i] < lo ? lo : (v[i] > hi ? hi : v[i]); // comparisons with NaN are false, so NaN stays NaN
+        } else if(kernel == "log"){
+            checkParams(kernel, params, 0);
+            for(size_t i = 0; i < n; ++i) v[i] = std::log(v[i]);
+        } else if(kernel == "exp"){
+            checkParams(kernel, params, 0);
+            for(size_t i = 0; i < n; ++i) v[i] = std::exp(v[i]);
+        } else if(kernel == "pow"){
+            checkParams(kernel, params, 1);
+            double p = params[0];
+            if(p == 2){ // by far the most common case, and much faster than 'pow()'
+                for(size_t i = 0; i < n; ++i) v[i] = v[i] * v[i];
+            } else if(p == 0){ // 'pow(NaN, 0)' is 1, so NA would become 1
+                for(size_t i = 0; i < n; ++i) v[i] = std::isnan(v[i]) ? v[i] : 1;
+            } else {
+                for(size_t i = 0; i < n; ++i) v[i] = std::pow(v[i], p);
+            }
+        } else if(kernel == "reclassify"){
+            if(table1.size() < 2 || table2.size() != table1.size() - 1){
+                throw std::runtime_error("the 'reclassify' kernel needs at least two breaks and one fewer values than breaks");
+            }
+            if(std::any_of(table1.begin(), table1.end(), [](double val){ return std::isnan(val); })){
+                throw std::runtime_error("the breaks used by the 'reclassify' kernel can't be NA");
+            }
+            if(!std::is_sorted(table1.begin(), table1.end())){
+                throw std::runtime_error("the breaks used by the 'reclassify' kernel must be sorted");
+            }
+            double first = table1.front();
+            double last = table1.back();
+            for(size_t i = 0; i < n; ++i){
+                if(!(v[i] >= first && v[i] <= last)){ // also catches NaN
+                    v[i] = std::numeric_limits<double>::quiet_NaN();
+                    continue;
+                }
+                size_t k = std::upper_bound(table1.begin(), table1.end(), v[i]) - table1.begin(); // the first break greater than the value
+                v[i] = table2[std::min(k, table2.size()) - 1];
+            }
+        } else if(kernel == "lookup"){
+            if(table1.size() != table2.size()){
+                throw std::runtime_error("the 'lookup' kernel needs the same number of 'from' and 'to' values");
+            }
+            if(std::any_of(table1.begin(), table1.end(), [](double val){ return std::isnan(val); })){ // NaN can't be sorted
+                throw std::runtime_error("the 'from' values used by the 'lookup' kernel can't be NA");
+            }
+            std::vector<std::pair<double, double>> table(table1.size());
+            for(size_t i = 0; i < table1.size(); ++i) table[i] = std::make_pair(table1[i], table2[i]);
+            std::sort(table.begin(), table.end());
+            for(size_t i = 0; i < n; ++i){
+                auto itr = std::lower_bound(table.begin(), table.end(), v[i], [](const std::pair<double, double> &entry, double val){
+                    return entry.first < val;
+                });
+                if(itr != table.end() && itr->first == v[i]) v[i] = itr->second;
+            }
+        } else if(kernel == "replace_na"){
+            checkParams(kernel, params, 1);
+            double r = params[0];
+            for(size_t i = 0; i < n; ++i) v[i] = std::isnan(v[i]) ? r : v[i];
+        } else {
+            throw std::runtime_error("invalid kernel: '" + kernel + "'");
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef TRANSFORMKERNELS_H
+#define TRANSFORMKERNELS_H
+
+#include <string>
+#include <vector>
+
+// built-in transformations that are applied to a whole vector of cell values
+// at once (see 'Quadtree::transformValues()'). Each kernel is a simple loop
+// over a contiguous array with no function calls other than the math
+// functions, so the compiler can vectorize them. NA (NaN) values stay NA
+// unless the kernel is "replace_na".
+//
+// The kernels and their parameters:
+//   "scale" -> 'x * params[0] + params[1]'
+//   "clamp" -> limits the values to be between 'params[0]' and 'params[1]'
+//   "log" -> natural logarithm
+//   "exp" -> exponential
+//   "pow" -> 'x ^ params[0]'
+//   "reclassify" -> values in '[table1[i], table1[i + 1])' become 'table2[i]'
+//      ('table1' holds the sorted breaks, and the last interval also
+//      includes its upper break). Values outside the breaks become NA
+//   "lookup" -> values equal to 'table1[i]' become 'table2[i]'. Other values
+//      don't change
+//   "replace_na" -> NA values become 'params[0]'
+namespace transformKernels {
+    void apply(std::vector<double> &vals, const std::string &kernel, const std::vector<double> &params, const std::vector<double> &table1, const std::vector<double> &table2);
+}
+
+#endif
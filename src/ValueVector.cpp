@@ -0,0 +1,172 @@
+#include "ValueVector.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    const int16_t INT16_NA = -32768;
+    const uint8_t UINT8_NA = 255;
+}
+
+// ------- constructors -------
+ValueVector::ValueVector(){}
+
+ValueVector::ValueVector(Type _type, const std::vector<double> &vals)
+    : type{_type}{
+    switch(type){
+        case Type::Double: doubles.resize(vals.size()); break;
+        case Type::Float: floats.resize(vals.size()); break;
+        case Type::Int16: int16s.resize(vals.size()); break;
+        case Type::UInt8: uint8s.resize(vals.size()); break;
+    }
+    for(size_t i = 0; i < vals.size(); ++i){
+        set(i, vals[i]);
+    }
+}
+
+// copies 'n' values that are stored as the raw bytes of 'type' (see 'bytes()')
+ValueVector::ValueVector(Type _type, const void *bytes, size_t n)
+    : type{_type}{
+    switch(type){
+        case Type::Double: doubles.resize(n); break;
+        case Type::Float: floats.resize(n); break;
+        case Type::Int16: int16s.resize(n); break;
+        case Type::UInt8: uint8s.resize(n); break;
+    }
+    if(n > 0) std::memcpy(const_cast<void*>(this->bytes()), bytes, n * typeSize(type));
+}
+
+ValueVector::Type ValueVector::getType() const{
+    return type;
+}
+
+size_t ValueVector::size() const{
+    switch(type){
+        case Type::Float: return floats.size();
+        case Type::Int16: return int16s.size();
+        case Type::UInt8: return uint8s.size();
+        default: return doubles.size();
+    }
+}
+
+// ------- get -------
+// returns element 'i' as a double - NA values are returned as NaN
+double ValueVector::get(size_t i) const{
+    switch(type){
+        case Type::Float: return floats[i];
+        case Type::Int16: return int16s[i] == INT16_NA ? std::numeric_limits<double>::quiet_NaN() : int16s[i];
+        case Type::UInt8: return uint8s[i] == UINT8_NA ? std::numeric_limits<double>::quiet_NaN() : uint8s[i];
+        default: return doubles[i];
+    }
+}
+
+// ------- set -------
+// converts 'val' to the storage type (see 'convert()') and stores it as
+// element 'i'
+void ValueVector::set(size_t i, double val){
+    val = convert(type, val);
+    switch(type){
+        case Type::Float: floats[i] = static_cast<float>(val); break;
+        case Type::Int16: int16s[i] = std::isnan(val) ? INT16_NA : static_cast<int16_t>(val); break;
+        case Type::UInt8: uint8s[i] = std::isnan(val) ? UINT8_NA : static_cast<uint8_t>(val); break;
+        default: doubles[i] = val; break;
+    }
+}
+
+std::vector<double> ValueVector::asDoubles() const{
+    std::vector<double> vals(size());
+    for(size_t i = 0; i < vals.size(); ++i){
+        vals[i] = get(i);
+    }
+    return vals;
+}
+
+// returns the values as they're stored (i.e. 'size() * typeSize(getType())'
+// bytes)
+const void* ValueVector::bytes() const{
+    switch(type){
+        case Type::Float: return floats.data();
+        case Type::Int16: return int16s.data();
+        case Type::UInt8: return uint8s.data();
+        default: return doubles.data();
+    }
+}
+
+size_t ValueVector::typeSize(Type type){
+    switch(type){
+        case Type::Float: return sizeof(float);
+        case Type::Int16: return sizeof(int16_t);
+        case Type::UInt8: return sizeof(uint8_t);
+        default: return sizeof(double);
+    }
+}
+
+// returns element 'i' of values that are stored as the raw bytes of 'type',
+// without copying them into a 'ValueVector' first
+double ValueVector::get(Type type, const void *bytes, size_t i){
+    switch(type){
+        case Type::Float: {
+            float val;
+            std::memcpy(&val, static_cast<const char*>(bytes) + i * sizeof(float), sizeof(float));
+            return val;
+        }
+        case Type::Int16: {
+            int16_t val;
+            std::memcpy(&val, static_cast<const char*>(bytes) + i * sizeof(int16_t), sizeof(int16_t));
+            return val == INT16_NA ? std::numeric_limits<double>::quiet_NaN() : val;
+        }
+        case Type::UInt8: {
+            uint8_t val = static_cast<const uint8_t*>(bytes)[i];
+            return val == UINT8_NA ? std::numeric_limits<double>::quiet_NaN() : val;
+        }
+        default: {
+            double val;
+            std::memcpy(&val, static_cast<const char*>(bytes) + i * sizeof(double), sizeof(double));
+            return val;
+        }
+    }
+}
+
+// ------- typeFromString -------
+ValueVector::Type ValueVector::typeFromString(const std::string &str){
+    if(str == "double") return Type::Double;
+    if(str == "float") return Type::Float;
+    if(str == "int16") return Type::Int16;
+    if(str == "uint8") return Type::UInt8;
+    throw std::runtime_error("invalid value type: '" + str + "' - must be 'double', 'float', 'int16', or 'uint8'");
+}
+
+std::string ValueVector::typeToString(Type type){
+    switch(type){
+        case Type::Float: return "float";
+        case Type::Int16: return "int16";
+        case Type::UInt8: return "uint8";
+        default: return "double";
+    }
+}
+
+// ------- convert -------
+// returns the value 'val' would have after being stored as 'type' - i.e.
+// rounded to the precision of the type, or NaN if it can't be represented.
+// Integers are rounded with 'std::nearbyint()', which (like R's 'round()')
+// rounds halves to the nearest even number.
+double ValueVector::convert(Type type, double val){
+    if(std::isnan(val)) return val;
+    switch(type){
+        case Type::Float: {
+            float f = static_cast<float>(val);
+            return std::isinf(f) && !std::isinf(val) ? std::numeric_limits<double>::quiet_NaN() : f;
+        }
+        case Type::Int16: {
+            double rounded = std::nearbyint(val);
+            return rounded < -32767 || rounded > 32767 ? std::numeric_limits<double>::quiet_NaN() : rounded;
+        }
+        case Type::UInt8: {
+            double rounded = std::nearbyint(val);
+            return rounded < 0 || rounded > 254 ? std::numeric_limits<double>::quiet_NaN() : rounded;
+        }
+        default: return val;
+    }
+}
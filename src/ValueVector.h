@@ -0,0 +1,66 @@
+#ifndef VALUEVECTOR_H
+#define VALUEVECTOR_H
+
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// vector of cell values that can be stored using a smaller type than 'double'.
+// Values are always given and returned as doubles - they're converted to the
+// storage type when they're set:
+//   "double" -> stored as-is
+//   "float" -> rounded to the nearest 32-bit float. NA is stored as NaN
+//   "int16" -> rounded to the nearest integer. NA (and any value outside of
+//      [-32767, 32767]) is stored as -32768
+//   "uint8" -> rounded to the nearest integer. NA (and any value outside of
+//      [0, 254]) is stored as 255
+// The NA values are the same as the ones used by GDAL and 'terra' for these
+// data types. Only the vector for the storage type is used - the others are
+// always empty.
+class ValueVector{
+public:
+    enum class Type {Double, Float, Int16, UInt8};
+
+private:
+    Type type{Type::Double};
+    std::vector<double> doubles;
+    std::vector<float> floats;
+    std::vector<int16_t> int16s;
+    std::vector<uint8_t> uint8s;
+
+public:
+    ValueVector();
+    ValueVector(Type _type, const std::vector<double> &vals);
+    ValueVector(Type _type, const void *bytes, size_t n);
+
+    Type getType() const;
+    size_t size() const;
+    double get(size_t i) const;
+    void set(size_t i, double val);
+    std::vector<double> asDoubles() const;
+    const void* bytes() const;
+
+    static size_t typeSize(Type type);
+    static double get(Type type, const void *bytes, size_t i);
+
+    static Type typeFromString(const std::string &str);
+    static std::string typeToString(Type type);
+    static double convert(Type type, double val);
+
+    template<class Archive>
+    void save(Archive & archive) const{
+        archive(static_cast<int>(type), doubles, floats, int16s, uint8s);
+    }
+    template<class Archive>
+    void load(Archive & archive){
+        int typeInt{0};
+        archive(typeInt, doubles, floats, int16s, uint8s);
+        type = static_cast<Type>(typeInt);
+    }
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "NodeWrapper.h"
 #include "QuadtreeWrapper.h"
 #include "LcpFinderWrapper.h"
+#include "MappedQuadtreeWrapper.h"
 
 RCPP_MODULE(qt) {
   using namespace Rcpp;
@@ -28,13 +29,29 @@ RCPP_MODULE(qt) {
     .method("nNodes", &QuadtreeWrapper::nNodes)
     .method("root", &QuadtreeWrapper::root)
     .method("createTree", &QuadtreeWrapper::createTree)
+    .method("restructure", &QuadtreeWrapper::restructure)
+    .method("createLayeredTree", &QuadtreeWrapper::createLayeredTree)
+    .method("addLayer", &QuadtreeWrapper::addLayer)
+    .method("getLayerNames", &QuadtreeWrapper::getLayerNames)
+    .method("getActiveLayer", &QuadtreeWrapper::getActiveLayer)
+    .method("getValueType", &QuadtreeWrapper::getValueType)
+    .method("setActiveLayer", &QuadtreeWrapper::setActiveLayer)
     .method("getValues", &QuadtreeWrapper::getValues)
+    .method("getLayerValues", &QuadtreeWrapper::getLayerValues)
     .method("setValues", &QuadtreeWrapper::setValues)
     .method("transformValues", &QuadtreeWrapper::transformValues)
+    .method("transformValuesVectorized", &QuadtreeWrapper::transformValuesVectorized)
+    .method("transformValuesKernel", &QuadtreeWrapper::transformValuesKernel)
     .method("getCell", &QuadtreeWrapper::getCell)
     .method("getCells", &QuadtreeWrapper::getCells)
     .method("getCellsDetails", &QuadtreeWrapper::getCellsDetails)
     .method("getNeighbors", &QuadtreeWrapper::getNeighbors)
+    .method("getComponents", &QuadtreeWrapper::getComponents)
+    .method("getComponentsQuadtree", &QuadtreeWrapper::getComponentsQuadtree)
+    .method("getCorridor", &QuadtreeWrapper::getCorridor)
+    .method("getCircuitConnectivity", &QuadtreeWrapper::getCircuitConnectivity)
+    .method("getBetweenness", &QuadtreeWrapper::getBetweenness)
+    .method("randomWalk", &QuadtreeWrapper::randomWalk)
     .method("asList", &QuadtreeWrapper::asList)
     .method("print", &QuadtreeWrapper::print)
     .method("getNeighborList", &QuadtreeWrapper::getNeighborList)
@@ -54,11 +71,35 @@ RCPP_MODULE(qt) {
     .method("makeNetworkAll", &LcpFinderWrapper::makeNetworkAll)
     .method("makeNetworkCostDist", &LcpFinderWrapper::makeNetworkCostDist)
     .method("getLcp", &LcpFinderWrapper::getLcp)
+    .method("getLcps", &LcpFinderWrapper::getLcps)
     .method("getAllPathsSummary", &LcpFinderWrapper::getAllPathsSummary)
+    .method("getLcpTree", &LcpFinderWrapper::getLcpTree)
+    .method("getIsochrones", &LcpFinderWrapper::getIsochrones)
     .method("getStartPoint", &LcpFinderWrapper::getStartPoint)
     .method("getSearchLimits", &LcpFinderWrapper::getSearchLimits);
 
+  class_<MappedQuadtreeWrapper>("CppMappedQuadtree")
+    .method("nNodes", &MappedQuadtreeWrapper::nNodes)
+    .method("nCells", &MappedQuadtreeWrapper::nCells)
+    .method("minCellSize", &MappedQuadtreeWrapper::minCellSize)
+    .method("extent", &MappedQuadtreeWrapper::extent)
+    .method("originalExtent", &MappedQuadtreeWrapper::originalExtent)
+    .method("originalDim", &MappedQuadtreeWrapper::originalDim)
+    .method("projection", &MappedQuadtreeWrapper::getProjection)
+    .method("getLayerNames", &MappedQuadtreeWrapper::getLayerNames)
+    .method("getActiveLayer", &MappedQuadtreeWrapper::getActiveLayer)
+    .method("getValueType", &MappedQuadtreeWrapper::getValueType)
+    .method("getValues", &MappedQuadtreeWrapper::getValues)
+    .method("getLayerValues", &MappedQuadtreeWrapper::getLayerValues)
+    .method("getCellsDetails", &MappedQuadtreeWrapper::getCellsDetails)
+    .method("toQuadtree", &MappedQuadtreeWrapper::toQuadtree);
+
   function("readQuadtreeCpp", &QuadtreeWrapper::readQuadtree);
+  function("readQuadtreeWindowCpp", &QuadtreeWrapper::readQuadtreeWindow);
   function("writeQuadtreeCpp", &QuadtreeWrapper::writeQuadtree);
   function("writeQuadtreePtr", &QuadtreeWrapper::writeQuadtreePtr);
+  function("writeQuadtreeFlatCpp", &QuadtreeWrapper::writeQuadtreeFlat);
+  function("writeQuadtreeCompactCpp", &QuadtreeWrapper::writeQuadtreeCompact);
+  function("quadtreeInfoCpp", &QuadtreeWrapper::quadtreeInfo);
+  function("mapQuadtreeCpp", &MappedQuadtreeWrapper::mapQuadtree);
 }
\ No newline at end of file